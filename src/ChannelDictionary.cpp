@@ -0,0 +1,37 @@
+/*
+ * ChannelDictionary.cpp
+ *
+ *  Created on: 17.10.2026
+ *   Copyright: 2026 by Janitza electronics GmbH
+ */
+
+#include "ChannelDictionary.hpp"
+
+ChannelDictionary::ChannelDictionary() :
+	m_channels(),
+	m_names(),
+	m_emitted() {}
+
+uint32_t ChannelDictionary::getChannel(const std::string& name) {
+	const auto it = m_channels.find(name);
+	if(it != m_channels.end()) {
+		return it->second;
+	}
+	const uint32_t channel = m_names.size();
+	m_channels.emplace(name, channel);
+	m_names.push_back(name);
+	m_emitted.push_back(false);
+	return channel;
+}
+
+const std::string& ChannelDictionary::getName(const uint32_t& channel) const {
+	return m_names.at(channel);
+}
+
+void ChannelDictionary::emit(std::ostream& out, const uint32_t& channel) {
+	if(m_emitted[channel]) {
+		return;
+	}
+	out << "{ \"channel\" : " << channel << ", \"name\" : \"" << m_names[channel] << "\" }," << std::endl;
+	m_emitted[channel] = true;
+}
@@ -0,0 +1,52 @@
+/*
+ * ChannelDictionary.hpp
+ *
+ *  Created on: 17.10.2026
+ *   Copyright: 2026 by Janitza electronics GmbH
+ */
+
+#ifndef CHANNELDICTIONARY_HPP_
+#define CHANNELDICTIONARY_HPP_
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <ostream>
+#include <cstdint>
+
+/**
+ * Maps the names of recorded values (browse path plus array index) to small channel ids.
+ * The output refers to values by channel id; the name of a channel is printed only once,
+ * before its first use.
+ */
+class ChannelDictionary {
+public:
+	ChannelDictionary();
+
+	/**
+	 * Get the channel id of a name; a new id is assigned to unknown names.
+	 * @param name Name of the value
+	 * @return Channel id
+	 */
+	uint32_t getChannel(const std::string& name);
+
+	/**
+	 * @param channel Channel id
+	 * @return Name of the channel
+	 */
+	const std::string& getName(const uint32_t& channel) const;
+
+	/**
+	 * Print the definition of a channel, if it was not printed before.
+	 * @param out Stream to print to
+	 * @param channel Channel id
+	 */
+	void emit(std::ostream& out, const uint32_t& channel);
+
+private:
+	std::unordered_map<std::string, uint32_t> m_channels;
+	std::vector<std::string> m_names;
+	std::vector<bool> m_emitted;
+};
+
+#endif /* CHANNELDICTIONARY_HPP_ */
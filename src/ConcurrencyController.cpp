@@ -0,0 +1,84 @@
+/*
+ * ConcurrencyController.cpp
+ *
+ *  Created on: 17.10.2026
+ *   Copyright: 2026 by Janitza electronics GmbH
+ */
+
+#include "ConcurrencyController.hpp"
+
+#include <algorithm>
+
+ConcurrencyController::Slot::Slot(ConcurrencyController& controller) :
+	m_controller(controller),
+	m_start(),
+	m_done(false) {
+	m_controller.acquire();
+	// Waiting for the slot is no latency of the device; counting it would lower the limit further
+	m_start = std::chrono::steady_clock::now();
+}
+
+ConcurrencyController::Slot::~Slot() {
+	if(!m_done) {
+		done(UA_STATUSCODE_BADINTERNALERROR);
+	}
+}
+
+void ConcurrencyController::Slot::done(const UA_StatusCode& status) {
+	if(m_done) {
+		return;
+	}
+	m_done = true;
+	m_controller.release(std::chrono::steady_clock::now() - m_start, status);
+}
+
+ConcurrencyController::ConcurrencyController(const unsigned& ceiling) :
+	m_mutex(),
+	m_released(),
+	m_ceiling(std::max(1u, ceiling)),
+	m_limit(1.0),
+	m_outstanding(0),
+	m_bestLatency(std::chrono::steady_clock::duration::max()),
+	m_lastDecrease() {}
+
+void ConcurrencyController::setCeiling(const unsigned& ceiling) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_ceiling = std::max(1u, ceiling);
+	m_limit = std::min(m_limit, (double)m_ceiling);
+	m_released.notify_all();
+}
+
+unsigned ConcurrencyController::getLimit() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return (unsigned)m_limit;
+}
+
+void ConcurrencyController::acquire() {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_released.wait(lock, [this]() { return m_outstanding < (unsigned)m_limit; });
+	m_outstanding++;
+}
+
+void ConcurrencyController::release(const std::chrono::steady_clock::duration& latency, const UA_StatusCode& status) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	const auto now = std::chrono::steady_clock::now();
+	m_outstanding--;
+
+	const bool good = (status == UA_STATUSCODE_GOOD);
+	if(good) {
+		m_bestLatency = std::min(m_bestLatency, latency);
+	}
+	if(!good || latency > m_bestLatency * LatencyTolerance) {
+		/* Decrease at most once per round trip, otherwise all requests that were outstanding
+		 * during an overload would shrink the limit one after another.
+		 */
+		if(now - m_lastDecrease > latency) {
+			m_limit = std::max(1.0, m_limit * DecreaseFactor);
+			m_lastDecrease = now;
+		}
+	} else {
+		// Increase by one after a full window of requests has completed
+		m_limit = std::min((double)m_ceiling, m_limit + 1.0 / m_limit);
+	}
+	m_released.notify_all();
+}
@@ -0,0 +1,85 @@
+/*
+ * ConcurrencyController.hpp
+ *
+ *  Created on: 17.10.2026
+ *   Copyright: 2026 by Janitza electronics GmbH
+ */
+
+#ifndef CONCURRENCYCONTROLLER_HPP_
+#define CONCURRENCYCONTROLLER_HPP_
+
+#include <open62541/types.h>
+
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+/**
+ * Limits the number of outstanding requests to a single device.
+ * The limit is adapted by additive-increase/multiplicative-decrease (AIMD): every successful
+ * request with a latency close to the best observed latency raises the limit by about one per
+ * round trip, while errors or a latency much higher than the best one halve it.
+ * The limit never drops below one and never exceeds the configured ceiling.
+ * A Slot blocks until a request may be sent, so the controller limits requests of multiple
+ * threads (e.g. the shard sessions of a recording); a single thread holds at most one Slot.
+ */
+class ConcurrencyController {
+public:
+	/**
+	 * RAII helper that holds one request slot of a controller.
+	 * If no result is reported before destruction, the request is treated as failed.
+	 */
+	class Slot {
+	public:
+		explicit Slot(ConcurrencyController& controller);
+		~Slot();
+		Slot(const Slot&) = delete;
+		Slot& operator=(const Slot&) = delete;
+
+		/**
+		 * Report the result of the request; the latency is measured since the slot was acquired,
+		 * so the time spent waiting for it does not count.
+		 * @param status Result of the request
+		 */
+		void done(const UA_StatusCode& status);
+
+	private:
+		ConcurrencyController& m_controller;
+		std::chrono::steady_clock::time_point m_start;
+		bool m_done;
+	};
+
+	/**
+	 * @param ceiling Maximum number of outstanding requests
+	 */
+	explicit ConcurrencyController(const unsigned& ceiling = 1);
+
+	/**
+	 * Change the maximum number of outstanding requests. The current limit is clipped accordingly.
+	 */
+	void setCeiling(const unsigned& ceiling);
+
+	/**
+	 * @return Current number of requests allowed to be outstanding at the same time
+	 */
+	unsigned getLimit() const;
+
+private:
+	void acquire();
+	void release(const std::chrono::steady_clock::duration& latency, const UA_StatusCode& status);
+
+	/** Latency compared to the best latency which is treated as overload */
+	static constexpr double LatencyTolerance = 2.0;
+	/** Factor the limit is multiplied with on overload */
+	static constexpr double DecreaseFactor = 0.5;
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_released;
+	unsigned m_ceiling;
+	double m_limit;
+	unsigned m_outstanding;
+	std::chrono::steady_clock::duration m_bestLatency;
+	std::chrono::steady_clock::time_point m_lastDecrease;
+};
+
+#endif /* CONCURRENCYCONTROLLER_HPP_ */
@@ -0,0 +1,198 @@
+/*
+ * DecodePlan.cpp
+ *
+ *  Created on: 17.10.2026
+ *   Copyright: 2026 by Janitza electronics GmbH
+ */
+
+#include "DecodePlan.hpp"
+
+#include <iostream>
+#include <cstdio>
+#include <charconv>
+
+namespace {
+
+/*
+ * Append a value formatted like std::ostream does by default, so the output does not depend
+ * on the decoder used.
+ */
+void append(std::string& s, const double& v) {
+	char buf[32];
+	s.append(buf, std::snprintf(buf, sizeof(buf), "%g", v));
+}
+
+void append(std::string& s, const float& v) {
+	append(s, static_cast<double>(v));
+}
+
+void append(std::string& s, const bool& v) {
+	s += v ? '1' : '0';
+}
+
+template<typename T>
+void append(std::string& s, const T& v) {
+	char buf[24];
+	s.append(buf, std::to_chars(buf, buf + sizeof(buf), v).ptr - buf);
+}
+
+/*
+ * Typed columns of a point for a data type
+ */
+template<UA_RecordingDataType Type> struct Tuple;
+template<> struct Tuple<UA_RECORDINGDATATYPE_BOOLEAN> {
+	static const RecordedTuple<bool>& get(const RecordedColumns& p) { return p.bool_(); }
+};
+template<> struct Tuple<UA_RECORDINGDATATYPE_INT32> {
+	static const RecordedTuple<int32_t>& get(const RecordedColumns& p) { return p.sint32(); }
+};
+template<> struct Tuple<UA_RECORDINGDATATYPE_UINT32> {
+	static const RecordedTuple<uint32_t>& get(const RecordedColumns& p) { return p.uint32(); }
+};
+template<> struct Tuple<UA_RECORDINGDATATYPE_INT64> {
+	static const RecordedTuple<int64_t>& get(const RecordedColumns& p) { return p.sint64(); }
+};
+template<> struct Tuple<UA_RECORDINGDATATYPE_UINT64> {
+	static const RecordedTuple<uint64_t>& get(const RecordedColumns& p) { return p.uint64(); }
+};
+template<> struct Tuple<UA_RECORDINGDATATYPE_FLOAT> {
+	static const RecordedTuple<float>& get(const RecordedColumns& p) { return p.float_(); }
+};
+template<> struct Tuple<UA_RECORDINGDATATYPE_DOUBLE> {
+	static const RecordedTuple<double>& get(const RecordedColumns& p) { return p.double_(); }
+};
+
+}
+
+DecodePlan::DecodePlan(const Recording::RecordingConfiguration& cfg, const bool& channels) :
+	m_algorithm(cfg.algorithm),
+	m_minimum(cfg.extremals.minimum),
+	m_maximum(cfg.extremals.maximum),
+	m_timestamps(cfg.extremals.timestamps),
+	m_types(),
+	m_prefixes(),
+	m_slots(),
+	m_validated(false) {
+	for(const auto& var : cfg.values) {
+		const UA_RecordingDataType type = var.info.typeInfo.dataType;
+		if(type <= UA_RECORDINGDATATYPE_UNDEFINED || type >= (int)m_types.size()) {
+			std::cerr << "Found UNDEFINED datatype; this should _not_ happen!";
+			continue;
+		}
+		TypePlan& plan = m_types[type];
+		// Values that are not available still take their place in the typed arrays
+		if(var.info.status == UA_REFERENCESTATUS_AVAILABLE) {
+			plan.slots.push_back({plan.count, (uint32_t)m_prefixes.size()});
+			std::string prefix = "\"" + (channels ? std::to_string(var.channel) : var.name) + "\" : { ";
+			prefix += (m_algorithm == UA_RECORDINGALGORITHM_AVERAGE) ? "\"avg\" : " : "\"sample\" : ";
+			m_prefixes.push_back(prefix);
+		}
+		plan.count++;
+	}
+	for(size_t type = UA_RECORDINGDATATYPE_BOOLEAN; type < m_types.size(); type++) {
+		if(!m_types[type].slots.empty()) {
+			m_types[type].kernel = selectKernel(static_cast<UA_RecordingDataType>(type), cfg.algorithm, cfg.extremals);
+		}
+	}
+	m_slots.resize(m_prefixes.size());
+}
+
+template<typename T>
+bool DecodePlan::validate(const T& tuple, const TypePlan& plan, const UA_RecordingDataType& type, const bool& report) const {
+	const int count = plan.count;
+	const int values = (m_algorithm == UA_RECORDINGALGORITHM_AVERAGE) ? tuple.avgvalue_size() : tuple.sample_size();
+	bool ok = (values == count);
+	if(m_minimum) {
+		ok = ok && tuple.minvalue_size() == count && (!m_timestamps || tuple.mintimestamp_size() == count);
+	}
+	if(m_maximum) {
+		ok = ok && tuple.maxvalue_size() == count && (!m_timestamps || tuple.maxtimestamp_size() == count);
+	}
+	if(!ok && report) {
+		std::cerr << "Recording point holds " << values << " values of datatype " << type
+				<< ", but the RecordingConfiguration defines " << count << std::endl;
+	}
+	return ok;
+}
+
+bool DecodePlan::validate(const RecordedColumns& point) {
+	// The first point is checked for all types, later points only for the types printed
+	const bool all = !m_validated;
+	bool ok = true;
+	if(all || m_types[UA_RECORDINGDATATYPE_BOOLEAN].count) ok = validate(point.bool_(), m_types[UA_RECORDINGDATATYPE_BOOLEAN], UA_RECORDINGDATATYPE_BOOLEAN, all) && ok;
+	if(all || m_types[UA_RECORDINGDATATYPE_INT32].count) ok = validate(point.sint32(), m_types[UA_RECORDINGDATATYPE_INT32], UA_RECORDINGDATATYPE_INT32, all) && ok;
+	if(all || m_types[UA_RECORDINGDATATYPE_UINT32].count) ok = validate(point.uint32(), m_types[UA_RECORDINGDATATYPE_UINT32], UA_RECORDINGDATATYPE_UINT32, all) && ok;
+	if(all || m_types[UA_RECORDINGDATATYPE_INT64].count) ok = validate(point.sint64(), m_types[UA_RECORDINGDATATYPE_INT64], UA_RECORDINGDATATYPE_INT64, all) && ok;
+	if(all || m_types[UA_RECORDINGDATATYPE_UINT64].count) ok = validate(point.uint64(), m_types[UA_RECORDINGDATATYPE_UINT64], UA_RECORDINGDATATYPE_UINT64, all) && ok;
+	if(all || m_types[UA_RECORDINGDATATYPE_FLOAT].count) ok = validate(point.float_(), m_types[UA_RECORDINGDATATYPE_FLOAT], UA_RECORDINGDATATYPE_FLOAT, all) && ok;
+	if(all || m_types[UA_RECORDINGDATATYPE_DOUBLE].count) ok = validate(point.double_(), m_types[UA_RECORDINGDATATYPE_DOUBLE], UA_RECORDINGDATATYPE_DOUBLE, all) && ok;
+	if(ok) {
+		m_validated = true;
+	} else if(!all) {
+		std::cerr << "Recording point does not match its RecordingConfiguration" << std::endl;
+	}
+	return ok;
+}
+
+template<UA_RecordingDataType Type, bool Average, bool Minimum, bool Maximum, bool Timestamps>
+void DecodePlan::kernel(DecodePlan& plan, const TypePlan& type, const RecordedColumns& point) {
+	const auto& tuple = Tuple<Type>::get(point);
+	const auto& values = Average ? tuple.avgvalue() : tuple.sample();
+	for(const Slot& s : type.slots) {
+		std::string& out = plan.m_slots[s.slot];
+		out = plan.m_prefixes[s.slot];
+		append(out, values[s.index]);
+		out += ' ';
+		if constexpr(Minimum) {
+			out += ", \"min\" : ";
+			append(out, tuple.minvalue(s.index));
+			out += ' ';
+			if constexpr(Timestamps) {
+				out += ", \"min_time\" : ";
+				append(out, tuple.mintimestamp(s.index));
+				out += ' ';
+			}
+		}
+		if constexpr(Maximum) {
+			out += ", \"max\" : ";
+			append(out, tuple.maxvalue(s.index));
+			out += ' ';
+			if constexpr(Timestamps) {
+				out += ", \"max_time\" : ";
+				append(out, tuple.maxtimestamp(s.index));
+				out += ' ';
+			}
+		}
+		out += " }, \n";
+	}
+}
+
+/*
+ * Table of all kernels. The index is built from the data type (1..7) and the flags
+ * average, minimum, maximum and timestamps (in this order from the highest bit).
+ */
+template<size_t... I>
+constexpr std::array<DecodePlan::Kernel, sizeof...(I)> DecodePlan::makeKernels(std::index_sequence<I...>) {
+	return {{ &kernel<static_cast<UA_RecordingDataType>(I / 16 + 1), (I & 8) != 0, (I & 4) != 0, (I & 2) != 0, (I & 1) != 0>... }};
+}
+
+DecodePlan::Kernel DecodePlan::selectKernel(const UA_RecordingDataType& type, const UA_RecordingAlgorithm& algorithm, const UA_RecordingExtremals& extremals) {
+	static constexpr auto Kernels = makeKernels(std::make_index_sequence<UA_RECORDINGDATATYPE_DOUBLE * 16>());
+	const size_t index = (type - 1) * 16
+			+ (algorithm == UA_RECORDINGALGORITHM_AVERAGE ? 8 : 0)
+			+ (extremals.minimum ? 4 : 0)
+			+ (extremals.maximum ? 2 : 0)
+			+ (extremals.timestamps ? 1 : 0);
+	return Kernels[index];
+}
+
+void DecodePlan::print(std::ostream& out, const RecordedColumns& point) {
+	for(const auto& type : m_types) {
+		if(type.kernel) {
+			type.kernel(*this, type, point);
+		}
+	}
+	for(const auto& s : m_slots) {
+		out << s;
+	}
+}
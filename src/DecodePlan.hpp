@@ -0,0 +1,109 @@
+/*
+ * DecodePlan.hpp
+ *
+ *  Created on: 17.10.2026
+ *   Copyright: 2026 by Janitza electronics GmbH
+ */
+
+#ifndef DECODEPLAN_HPP_
+#define DECODEPLAN_HPP_
+
+#include "Recording.hpp"
+
+#include <array>
+#include <string>
+#include <vector>
+#include <ostream>
+#include <utility>
+
+/**
+ * Flat plan for decoding the recording points of one RecordingConfiguration.
+ * The configuration is compiled once: for each data type the positions of the available values
+ * in the typed columns and their output slots, and which extremals are present.
+ * Decoding a point then is a loop over the typed arrays, which fills the output slots, followed
+ * by writing the slots in the order of the configuration. The loops are kernels specialized at
+ * compile time for the data type, the algorithm and the extremals; the kernel of each type is
+ * selected once, when the plan is compiled.
+ * @note A plan holds the buffers of the slots, so it must not be used by multiple threads at once.
+ */
+class DecodePlan {
+public:
+	/**
+	 * Compile a configuration
+	 * @param cfg Configuration of the points to be decoded
+	 * @param channels Refer to the values by channel id instead of their name
+	 */
+	DecodePlan(const Recording::RecordingConfiguration& cfg, const bool& channels);
+
+	/**
+	 * Check the array lengths of a point against the configuration. The first point is checked
+	 * completely and mismatches are reported; later points only by the lengths of the arrays read.
+	 * @param point Recording point
+	 * @return true if the point can be decoded by this plan
+	 */
+	bool validate(const RecordedColumns& point);
+
+	/**
+	 * Print the values of a validated point
+	 * @param out Output stream
+	 * @param point Recording point
+	 */
+	void print(std::ostream& out, const RecordedColumns& point);
+
+private:
+	/**
+	 * Value of a data type to be printed
+	 */
+	struct Slot {
+		/** Index in the typed columns of the point */
+		uint32_t index;
+		/** Position of the value in the output */
+		uint32_t slot;
+	};
+
+	struct TypePlan;
+
+	/**
+	 * Decode the values of one data type of a point into the output slots
+	 */
+	using Kernel = void (*)(DecodePlan& plan, const TypePlan& type, const RecordedColumns& point);
+
+	/**
+	 * All values of a data type
+	 */
+	struct TypePlan {
+		/** Number of values of the type in the configuration, including unavailable ones */
+		uint32_t count = 0;
+		std::vector<Slot> slots;
+		/** nullptr if no value of the type is printed */
+		Kernel kernel = nullptr;
+	};
+
+	template<typename T>
+	bool validate(const T& tuple, const TypePlan& plan, const UA_RecordingDataType& type, const bool& report) const;
+
+	template<UA_RecordingDataType Type, bool Average, bool Minimum, bool Maximum, bool Timestamps>
+	static void kernel(DecodePlan& plan, const TypePlan& type, const RecordedColumns& point);
+
+	template<size_t... I>
+	static constexpr std::array<Kernel, sizeof...(I)> makeKernels(std::index_sequence<I...>);
+
+	/**
+	 * Select the kernel of a data type for a configuration from the table of all instantiations
+	 */
+	static Kernel selectKernel(const UA_RecordingDataType& type, const UA_RecordingAlgorithm& algorithm, const UA_RecordingExtremals& extremals);
+
+	UA_RecordingAlgorithm m_algorithm;
+	bool m_minimum;
+	bool m_maximum;
+	bool m_timestamps;
+	/** Indexed by UA_RecordingDataType */
+	std::array<TypePlan, UA_RECORDINGDATATYPE_DOUBLE + 1> m_types;
+	/** Start of the output of each slot ("<name>" : { "avg" : ) */
+	std::vector<std::string> m_prefixes;
+	/** Output of each slot for the current point; reused for all points */
+	std::vector<std::string> m_slots;
+	bool m_validated;
+};
+
+#endif /* DECODEPLAN_HPP_ */
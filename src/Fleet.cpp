@@ -0,0 +1,120 @@
+/*
+ * Fleet.cpp
+ *
+ *  Created on: 17.10.2026
+ *   Copyright: 2026 by Janitza electronics GmbH
+ */
+
+#include "Fleet.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+Fleet::Fleet(const std::vector<Device>& devices, const unsigned& workers, const std::string& outputDir) :
+	m_devices(devices),
+	m_workers(std::max(1u, workers)),
+	m_outputDir(outputDir) {}
+
+bool Fleet::loadDeviceList(const std::string& file, std::vector<Device>& devices) {
+	std::ifstream in(file);
+	if(!in) {
+		std::cerr << "Failed to open device list '" << file << "'" << std::endl;
+		return false;
+	}
+	std::string line;
+	while(std::getline(in, line)) {
+		std::istringstream fields(line);
+		Device device = {"", 4840};
+		if(!(fields >> device.host) || device.host[0] == '#') {
+			continue;
+		}
+		fields >> device.port;
+		devices.push_back(device);
+	}
+	return true;
+}
+
+std::vector<Fleet::Result> Fleet::run(const ReadoutOptions& options) const {
+	std::vector<Result> results(m_devices.size());
+	std::atomic<size_t> next(0);
+	std::vector<std::thread> workers;
+
+	const size_t count = std::min<size_t>(m_workers, m_devices.size());
+	for(size_t w=0; w<count; w++) {
+		workers.emplace_back([this, &next, &results, &options]() {
+			for(size_t i = next++; i < m_devices.size(); i = next++) {
+				results[i] = readDevice(m_devices[i], options);
+			}
+		});
+	}
+	for(auto& w : workers) {
+		w.join();
+	}
+
+	return results;
+}
+
+Fleet::Result Fleet::readDevice(const Device& device, const ReadoutOptions& options) const {
+	Result result = {device, false, false, ReadoutSummary(), 0.0};
+	const auto t1 = std::chrono::steady_clock::now();
+
+	const std::string serverUrl = "opc.tcp://"+device.host+":"+std::to_string(device.port);
+	const std::filesystem::path file = std::filesystem::path(m_outputDir) / (device.host+"_"+std::to_string(device.port)+".txt");
+	// Incremental synchronization only writes new data, so append to the output of previous runs
+	std::ofstream out(file, options.syncState ? std::ios::app : std::ios::trunc);
+	if(!out) {
+		std::cerr << "Failed to open output file '" << file.string() << "'" << std::endl;
+		result.summary.status = UA_STATUSCODE_BADINTERNALERROR;
+		return result;
+	}
+	result.opened = true;
+
+	ReadoutOptions deviceOptions = options;
+	deviceOptions.makeDurable = [&out, &file]() {
+		out.flush();
+		return out.good() && SyncState::syncFile(file.string());
+	};
+
+	Umg801 umg;
+	umg.setOutput(out);
+	umg.setMetadataDir(options.metadataDir);
+	umg.setDictionaryOutput(options.channelDictionary);
+	umg.setVerifyDecoder(options.verifyDecoder);
+	umg.setRawRecordingPoints(options.rawRecordingPoints);
+	if(!umg.connect(serverUrl)) {
+		result.summary.status = UA_STATUSCODE_BADCONNECTIONCLOSED;
+	} else {
+		result.connected = true;
+		result.summary = umg.readout(deviceOptions);
+	}
+
+	const auto t2 = std::chrono::steady_clock::now();
+	result.seconds = std::chrono::duration<double>(t2 - t1).count();
+	return result;
+}
+
+void Fleet::printSummary(const std::vector<Result>& results, std::ostream& out) {
+	size_t failed = 0;
+	for(const auto& r : results) {
+		out << r.device.host << ":" << r.device.port << "\t";
+		if(!r.opened) {
+			out << "output file failed";
+		} else if(!r.connected) {
+			out << "connect failed";
+		} else {
+			out << r.summary.recordings << " recordings, " << r.summary.points << " points, "
+					<< UA_StatusCode_name(r.summary.status);
+		}
+		out << "\t" << r.seconds << "s" << std::endl;
+		if(r.summary.status != UA_STATUSCODE_GOOD) {
+			failed++;
+		}
+	}
+	out << results.size() << " devices, " << failed << " failed" << std::endl;
+}
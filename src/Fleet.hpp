@@ -0,0 +1,77 @@
+/*
+ * Fleet.hpp
+ *
+ *  Created on: 17.10.2026
+ *   Copyright: 2026 by Janitza electronics GmbH
+ */
+
+#ifndef FLEET_HPP_
+#define FLEET_HPP_
+
+#include "Umg801.hpp"
+
+#include <string>
+#include <vector>
+#include <ostream>
+
+/**
+ * Reads out many UMG801 devices concurrently from one process.
+ * A bounded pool of worker threads processes the device list; each worker owns one
+ * Umg801 session at a time. The data of each device is written to its own file,
+ * so the output of concurrent devices does not interleave.
+ */
+class Fleet {
+public:
+	struct Device {
+		std::string host;
+		uint16_t port;
+	};
+
+	struct Result {
+		Device device;
+		/** false if the output file of the device could not be opened; the device was not contacted then */
+		bool opened;
+		bool connected;
+		ReadoutSummary summary;
+		double seconds;
+	};
+
+	/**
+	 * @param devices Devices to be read out
+	 * @param workers Maximum number of devices read out at the same time
+	 * @param outputDir Directory the output file '<host>_<port>.txt' of each device is written to
+	 */
+	Fleet(const std::vector<Device>& devices, const unsigned& workers, const std::string& outputDir);
+
+	/**
+	 * Load a device list file. Each line holds '<host> [<port>]', empty lines and lines starting
+	 * with '#' are ignored.
+	 * @param file Path of the device list
+	 * @param devices Output parameter the devices are appended to
+	 * @return true on success
+	 */
+	static bool loadDeviceList(const std::string& file, std::vector<Device>& devices);
+
+	/**
+	 * Read out all devices.
+	 * @param options Options for reading out each device
+	 * @return Result of each device in order of the device list
+	 */
+	std::vector<Result> run(const ReadoutOptions& options) const;
+
+	/**
+	 * Print a per-device summary of a run.
+	 * @param results Results returned by run()
+	 * @param out Stream the summary is printed to
+	 */
+	static void printSummary(const std::vector<Result>& results, std::ostream& out);
+
+private:
+	Result readDevice(const Device& device, const ReadoutOptions& options) const;
+
+	const std::vector<Device> m_devices;
+	const unsigned m_workers;
+	const std::string m_outputDir;
+};
+
+#endif /* FLEET_HPP_ */
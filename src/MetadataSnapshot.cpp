@@ -0,0 +1,327 @@
+/*
+ * MetadataSnapshot.cpp
+ *
+ *  Created on: 17.10.2026
+ *   Copyright: 2026 by Janitza electronics GmbH
+ */
+
+#include "MetadataSnapshot.hpp"
+#include "SyncState.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <cstring>
+#include <cctype>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+constexpr char MetadataSnapshot::Magic[8];
+
+/*
+ * The file consists of the header (magic, version) followed by the sections namespaces,
+ * browse paths, children, lookup and configurations. Each section starts with its number of
+ * entries. Integers are stored in host byte order, strings with a 32 bit length prefix.
+ */
+namespace {
+
+class Writer {
+public:
+	template<typename T>
+	void put(const T& value) {
+		m_data.append(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+	void putString(const std::string& str) {
+		put<uint32_t>(str.size());
+		m_data.append(str);
+	}
+	void putNodeId(const NodeId& id) {
+		const UA_NodeId ua = id.toUaNodeId();
+		put<uint16_t>(ua.namespaceIndex);
+		put<uint8_t>(ua.identifierType);
+		if(ua.identifierType == UA_NODEIDTYPE_NUMERIC) {
+			put<uint32_t>(ua.identifier.numeric);
+		} else {
+			// String and ByteString share the same layout
+			putString(std::string(reinterpret_cast<const char*>(ua.identifier.string.data), ua.identifier.string.length));
+		}
+	}
+	const std::string& data() const {
+		return m_data;
+	}
+private:
+	std::string m_data;
+};
+
+class Reader {
+public:
+	Reader(const uint8_t* data, size_t size) : m_pos(data), m_end(data + size), m_ok(true) {}
+
+	template<typename T>
+	T get() {
+		T value = T();
+		if(check(sizeof(T))) {
+			memcpy(&value, m_pos, sizeof(T));
+			m_pos += sizeof(T);
+		}
+		return value;
+	}
+	std::string getString() {
+		const uint32_t length = get<uint32_t>();
+		if(!check(length)) {
+			return "";
+		}
+		std::string str(reinterpret_cast<const char*>(m_pos), length);
+		m_pos += length;
+		return str;
+	}
+	NodeId getNodeId() {
+		UA_NodeId ua;
+		ua.namespaceIndex = get<uint16_t>();
+		ua.identifierType = static_cast<UA_NodeIdType>(get<uint8_t>());
+		if(ua.identifierType == UA_NODEIDTYPE_NUMERIC) {
+			ua.identifier.numeric = get<uint32_t>();
+			return NodeId(ua);
+		}
+		const std::string str = getString();
+		ua.identifier.string.length = str.size();
+		ua.identifier.string.data = (UA_Byte*)str.data();
+		return m_ok ? NodeId(ua) : NodeId();
+	}
+	/** Number of entries of a section; each entry takes at least one byte, which limits bogus counts */
+	uint32_t getCount() {
+		const uint32_t count = get<uint32_t>();
+		return check(count) ? count : 0;
+	}
+	bool ok() const {
+		return m_ok;
+	}
+private:
+	bool check(size_t size) {
+		if(!m_ok || size > (size_t)(m_end - m_pos)) {
+			m_ok = false;
+		}
+		return m_ok;
+	}
+	const uint8_t* m_pos;
+	const uint8_t* const m_end;
+	bool m_ok;
+};
+
+}
+
+MetadataSnapshot::MetadataSnapshot() :
+	namespaces(),
+	browsePaths(),
+	children(),
+	lookup(),
+	configurations() {}
+
+bool MetadataSnapshot::load(const std::string& path) {
+	const int fd = ::open(path.c_str(), O_RDONLY);
+	if(fd < 0) {
+		return false;
+	}
+	struct stat st;
+	if(::fstat(fd, &st) != 0 || st.st_size < (off_t)(sizeof(Magic) + sizeof(Version))) {
+		::close(fd);
+		return false;
+	}
+	void* map = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if(map == MAP_FAILED) {
+		std::cerr << "Failed to map metadata snapshot '" << path << "': " << strerror(errno) << std::endl;
+		return false;
+	}
+
+	Reader in(static_cast<const uint8_t*>(map), st.st_size);
+	char magic[sizeof(Magic)];
+	for(auto& c : magic) {
+		c = in.get<char>();
+	}
+	if(memcmp(magic, Magic, sizeof(Magic)) != 0 || in.get<uint32_t>() != Version) {
+		std::cerr << "Ignoring metadata snapshot '" << path << "' of unknown format" << std::endl;
+		::munmap(map, st.st_size);
+		return false;
+	}
+
+	for(uint32_t n = in.getCount(); n > 0 && in.ok(); n--) {
+		namespaces.push_back(in.getString());
+	}
+	for(uint32_t n = in.getCount(); n > 0 && in.ok(); n--) {
+		BrowsePath p;
+		p.startingNode = in.getNodeId();
+		for(uint32_t e = in.getCount(); e > 0 && in.ok(); e--) {
+			PathElement element;
+			element.ns = in.get<uint16_t>();
+			element.browseName = in.getString();
+			element.referenceId = in.get<uint32_t>();
+			p.path.push_back(element);
+		}
+		browsePaths[p] = in.getNodeId();
+	}
+	for(uint32_t n = in.getCount(); n > 0 && in.ok(); n--) {
+		auto& nodes = children[in.getNodeId()];
+		for(uint32_t c = in.getCount(); c > 0 && in.ok(); c--) {
+			const std::string name = in.getString();
+			nodes[name] = in.getNodeId();
+		}
+	}
+	for(uint32_t n = in.getCount(); n > 0 && in.ok(); n--) {
+		auto& table = lookup[static_cast<UA_Tag>(in.get<int32_t>())];
+		for(uint32_t l = in.getCount(); l > 0 && in.ok(); l--) {
+			const NodeId id = in.getNodeId();
+			table[id] = in.getString();
+		}
+	}
+	for(uint32_t n = in.getCount(); n > 0 && in.ok(); n--) {
+		auto& configs = configurations[in.get<uint32_t>()];
+		for(uint32_t c = in.getCount(); c > 0 && in.ok(); c--) {
+			Recording::RecordingConfiguration cfg;
+			cfg.id = in.get<uint32_t>();
+			cfg.algorithm = static_cast<UA_RecordingAlgorithm>(in.get<int32_t>());
+			cfg.extremals.minimum = in.get<uint8_t>();
+			cfg.extremals.maximum = in.get<uint8_t>();
+			cfg.extremals.timestamps = in.get<uint8_t>();
+			cfg.interval_seconds = in.get<uint32_t>();
+			for(uint32_t v = in.getCount(); v > 0 && in.ok(); v--) {
+				UA_RecordingValueInfo info;
+				memset(&info, 0, sizeof(info));
+				info.status = static_cast<UA_ReferenceStatus>(in.get<int32_t>());
+				/* The NodeId of the value is only needed to lookup its browse path, which is stored
+				 * as well. So it is not restored to keep the info free of allocated memory.
+				 */
+				info.value.node = UA_NODEID_NUMERIC(0, 0);
+				info.value.arrayIndex = in.get<int32_t>();
+				info.typeInfo.dataType = static_cast<UA_RecordingDataType>(in.get<int32_t>());
+				info.typeInfo.array = in.get<uint8_t>();
+				info.typeInfo.arraySize = in.get<uint16_t>();
+				const std::string browsePath = in.getString();
+				cfg.values.emplace_back(info, browsePath);
+			}
+			configs.emplace(cfg.id, cfg);
+		}
+	}
+	::munmap(map, st.st_size);
+
+	if(!in.ok()) {
+		std::cerr << "Ignoring truncated metadata snapshot '" << path << "'" << std::endl;
+		*this = MetadataSnapshot();
+		return false;
+	}
+	return true;
+}
+
+bool MetadataSnapshot::save(const std::string& path) const {
+	Writer out;
+	for(const char c : Magic) {
+		out.put<char>(c);
+	}
+	out.put<uint32_t>(Version);
+
+	out.put<uint32_t>(namespaces.size());
+	for(const auto& ns : namespaces) {
+		out.putString(ns);
+	}
+	out.put<uint32_t>(browsePaths.size());
+	for(const auto& p : browsePaths) {
+		out.putNodeId(p.first.startingNode);
+		out.put<uint32_t>(p.first.path.size());
+		for(const auto& e : p.first.path) {
+			out.put<uint16_t>(e.ns);
+			out.putString(e.browseName);
+			out.put<uint32_t>(e.referenceId);
+		}
+		out.putNodeId(p.second);
+	}
+	out.put<uint32_t>(children.size());
+	for(const auto& n : children) {
+		out.putNodeId(n.first);
+		out.put<uint32_t>(n.second.size());
+		for(const auto& c : n.second) {
+			out.putString(c.first);
+			out.putNodeId(c.second);
+		}
+	}
+	out.put<uint32_t>(lookup.size());
+	for(const auto& t : lookup) {
+		out.put<int32_t>(t.first);
+		out.put<uint32_t>(t.second.size());
+		for(const auto& l : t.second) {
+			out.putNodeId(l.first);
+			out.putString(l.second);
+		}
+	}
+	out.put<uint32_t>(configurations.size());
+	for(const auto& r : configurations) {
+		out.put<uint32_t>(r.first);
+		out.put<uint32_t>(r.second.size());
+		for(const auto& c : r.second) {
+			const Recording::RecordingConfiguration& cfg = c.second;
+			out.put<uint32_t>(cfg.id);
+			out.put<int32_t>(cfg.algorithm);
+			out.put<uint8_t>(cfg.extremals.minimum);
+			out.put<uint8_t>(cfg.extremals.maximum);
+			out.put<uint8_t>(cfg.extremals.timestamps);
+			out.put<uint32_t>(cfg.interval_seconds);
+			out.put<uint32_t>(cfg.values.size());
+			for(const auto& v : cfg.values) {
+				out.put<int32_t>(v.info.status);
+				out.put<int32_t>(v.info.value.arrayIndex);
+				out.put<int32_t>(v.info.typeInfo.dataType);
+				out.put<uint8_t>(v.info.typeInfo.array);
+				out.put<uint16_t>(v.info.typeInfo.arraySize);
+				out.putString(v.browsePath);
+			}
+		}
+	}
+
+	/* Write a temporary file, flush it to disk and rename it, so neither a concurrent reader
+	 * nor a crash leaves a partial snapshot behind.
+	 */
+	const std::string tmp = path + ".tmp";
+	{
+		std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+		file.write(out.data().data(), out.data().size());
+		file.flush();
+		if(!file) {
+			std::cerr << "Failed to write metadata snapshot '" << tmp << "'" << std::endl;
+			return false;
+		}
+	}
+	if(!SyncState::syncFile(tmp)) {
+		return false;
+	}
+	if(::rename(tmp.c_str(), path.c_str()) != 0) {
+		std::cerr << "Failed to write metadata snapshot '" << path << "': " << strerror(errno) << std::endl;
+		return false;
+	}
+	// Make the rename itself durable
+	const std::filesystem::path dir = std::filesystem::path(path).parent_path();
+	return SyncState::syncFile(dir.empty() ? "." : dir.string());
+}
+
+size_t MetadataSnapshot::entries() const {
+	size_t n = namespaces.size() + browsePaths.size();
+	for(const auto& c : children) {
+		n += 1 + c.second.size();
+	}
+	for(const auto& t : lookup) {
+		n += 1 + t.second.size();
+	}
+	for(const auto& r : configurations) {
+		n += 1 + r.second.size();
+	}
+	return n;
+}
+
+std::string MetadataSnapshot::fileName(const std::string& dir, const std::string& url) {
+	std::string name;
+	for(const char c : url.substr(url.find("://") == std::string::npos ? 0 : url.find("://") + 3)) {
+		name += std::isalnum(static_cast<unsigned char>(c)) || c == '.' || c == '-' ? c : '_';
+	}
+	return (std::filesystem::path(dir) / (name + ".meta")).string();
+}
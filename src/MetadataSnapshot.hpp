@@ -0,0 +1,71 @@
+/*
+ * MetadataSnapshot.hpp
+ *
+ *  Created on: 17.10.2026
+ *   Copyright: 2026 by Janitza electronics GmbH
+ */
+
+#ifndef METADATASNAPSHOT_HPP_
+#define METADATASNAPSHOT_HPP_
+
+#include "OpcuaClient.hpp"
+#include "Recording.hpp"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+
+/**
+ * Metadata of a device that is discovered once and rarely changes: resolved browse paths,
+ * the browsed address space, the lookup table and the RecordingConfigurations.
+ * The snapshot is stored in a compact binary file, which is mapped into memory on load.
+ * It belongs to the device it was taken from as long as the NamespaceArray of the device
+ * is unchanged and no recordings or configurations were added (see Umg801::getRecordings()).
+ */
+class MetadataSnapshot {
+public:
+	MetadataSnapshot();
+
+	/**
+	 * Load a snapshot file.
+	 * @param path Path of the snapshot file
+	 * @return false if the file does not exist or is not a valid snapshot
+	 */
+	bool load(const std::string& path);
+
+	/**
+	 * Write the snapshot to a file. The file is replaced atomically and durably.
+	 * @param path Path of the snapshot file
+	 * @return true on success
+	 */
+	bool save(const std::string& path) const;
+
+	/**
+	 * @return Number of entries of all sections; the caches a snapshot is taken from only grow,
+	 *         so a snapshot with more entries holds new metadata
+	 */
+	size_t entries() const;
+
+	/**
+	 * @param dir Directory of the snapshot files
+	 * @param url URL of the device
+	 * @return Path of the snapshot file of the device
+	 */
+	static std::string fileName(const std::string& dir, const std::string& url);
+
+	/** NamespaceArray of the device; used to validate the snapshot */
+	std::vector<std::string> namespaces;
+	std::unordered_map<BrowsePath, NodeId, BrowsePathHash> browsePaths;
+	BrowseSnapshot children;
+	/** Complete lookup tables by tag */
+	std::map<UA_Tag, std::unordered_map<NodeId, std::string>> lookup;
+	/** RecordingConfigurations by Recording-Id */
+	std::map<uint32_t, Recording::RecordingConfigurations> configurations;
+
+private:
+	static constexpr char Magic[8] = {'U','M','G','M','E','T','A','\0'};
+	static constexpr uint32_t Version = 2;
+};
+
+#endif /* METADATASNAPSHOT_HPP_ */
@@ -15,6 +15,8 @@
 #include <sstream>
 #include <stdexcept>
 #include <algorithm>
+#include <unordered_set>
+#include <mutex>
 
 const NodeId NodeId::Null = NodeId();
 const std::string NodeId::InvalidString("?=?");
@@ -25,24 +27,20 @@ NodeId::NodeId()
   m_namespace(NullNamespace),
   m_identifier(Identifier::Numeric),
   m_numeric(NullNumeric),
-  m_stringOrByteString(nullptr) {}
-
-NodeId::NodeId(NodeId& other)
-: NodeId(const_cast<const NodeId&>(other)) {}
-
-NodeId::NodeId(const NodeId& other)
-: m_valid(other.m_valid),
-  m_namespace(other.m_namespace),
-  m_identifier(other.m_identifier),
-  m_numeric(other.m_numeric),
-  m_stringOrByteString(other.m_stringOrByteString ? std::make_shared<std::string>(*other.m_stringOrByteString) : nullptr) {}
+  m_stringOrByteString(nullptr),
+  m_hash(0) {
+	updateHash();
+}
 
 NodeId::NodeId(NamespaceT namespaceIndex, NumericT numeric)
 : m_valid(true),
   m_namespace(namespaceIndex),
   m_identifier(Identifier::Numeric),
   m_numeric(numeric),
-  m_stringOrByteString(nullptr) {}
+  m_stringOrByteString(nullptr),
+  m_hash(0) {
+	updateHash();
+}
 
 NodeId::NodeId(UA_NodeId& ua)
 : NodeId(const_cast<const UA_NodeId*>(&ua)) {}
@@ -58,7 +56,8 @@ NodeId::NodeId(const UA_NodeId* ua)
   m_namespace(ua ? ua->namespaceIndex : InvalidNamespace),
   m_identifier(Identifier::Unknown),
   m_numeric(InvalidNumeric),
-  m_stringOrByteString(nullptr) {
+  m_stringOrByteString(nullptr),
+  m_hash(0) {
 
 	if (ua) {
 		switch (ua->identifierType) {
@@ -69,16 +68,16 @@ NodeId::NodeId(const UA_NodeId* ua)
 			break;
 		case UA_NODEIDTYPE_STRING:
 			m_identifier = Identifier::String;
-			m_stringOrByteString = std::make_shared<std::string>(
+			m_stringOrByteString = intern(std::string(
 					reinterpret_cast<char*>(const_cast<UA_Byte*>(ua->identifier.string.data)),
-					ua->identifier.string.length);
+					ua->identifier.string.length));
 			m_valid = true;
 			break;
 		case UA_NODEIDTYPE_BYTESTRING:
 			m_identifier = Identifier::ByteString;
-			m_stringOrByteString = std::make_shared<std::string>(
+			m_stringOrByteString = intern(std::string(
 					reinterpret_cast<char*>(const_cast<UA_Byte*>(ua->identifier.byteString.data)),
-					ua->identifier.byteString.length);
+					ua->identifier.byteString.length));
 			m_valid = true;
 			break;
 		case UA_NODEIDTYPE_GUID:
@@ -88,21 +87,7 @@ NodeId::NodeId(const UA_NodeId* ua)
 			break;
 		}
 	}
-}
-
-NodeId& NodeId::operator =(const NodeId& other) {
-	if (this == &other) {
-		return *this;
-	}
-
-	m_valid = other.m_valid;
-	m_namespace = other.m_namespace;
-	m_identifier = other.m_identifier;
-	m_numeric = other.m_numeric;
-	m_stringOrByteString = (other.m_stringOrByteString
-			? std::make_shared<std::string>(*other.m_stringOrByteString)
-			: std::shared_ptr<std::string>(nullptr));
-	return *this;
+	updateHash();
 }
 
 NodeId& NodeId::operator =(const UA_NodeId& other) {
@@ -111,6 +96,9 @@ NodeId& NodeId::operator =(const UA_NodeId& other) {
 }
 
 bool NodeId::operator ==(const NodeId& other) const {
+	if (m_hash != other.m_hash) {
+		return false;
+	}
 	if (m_namespace != other.m_namespace) {
 		return false;
 	}
@@ -123,7 +111,7 @@ bool NodeId::operator ==(const NodeId& other) const {
 	case Identifier::String:
 		[[fallthrough]];
 	case Identifier::ByteString:
-		return (*m_stringOrByteString == *(other.m_stringOrByteString));
+		return (m_stringOrByteString == other.m_stringOrByteString); // interned
 	default:
 		std::cerr << "Tried to compare node IDs w/ unknown identifier!" << std::endl;
 		return false;
@@ -151,7 +139,8 @@ bool NodeId::operator <(const NodeId& other) const {
 	case Identifier::String:
 		[[fallthrough]];
 	case Identifier::ByteString:
-		return (*m_stringOrByteString < *(other.m_stringOrByteString));
+		return (m_stringOrByteString != other.m_stringOrByteString
+				&& *m_stringOrByteString < *(other.m_stringOrByteString));
 	case Identifier::Guid:
 	default:
 		std::cerr << "Tried to compare node IDs w/ unknown identifier!" << std::endl;
@@ -160,36 +149,15 @@ bool NodeId::operator <(const NodeId& other) const {
 }
 
 bool NodeId::operator <=(const NodeId& other) const {
-	return (*this == other || *this < other);
+	return !(other < *this);
 }
 
 bool NodeId::operator >(const NodeId& other) const {
-	if (m_namespace > other.m_namespace) {
-		return true;
-	} else if (m_namespace < other.m_namespace) {
-		return false;
-	}
-	if (m_identifier > other.m_identifier) {
-		return true;
-	} else if (m_identifier < other.m_identifier) {
-		return false;
-	}
-	switch (m_identifier) {
-	case Identifier::Numeric:
-		return (m_numeric > other.m_numeric);
-	case Identifier::String:
-		[[fallthrough]];
-	case Identifier::ByteString:
-		return (*m_stringOrByteString > *(other.m_stringOrByteString));
-	case Identifier::Guid:
-	default:
-		std::cerr << "Tried to compare node IDs w/ unknown identifier!" << std::endl;
-		return false;
-	}
+	return (other < *this);
 }
 
 bool NodeId::operator >=(const NodeId& other) const {
-	return (*this == other || *this > other);
+	return !(*this < other);
 }
 
 NodeId::operator std::string() const {
@@ -235,9 +203,10 @@ const UA_NodeId NodeId::toUaNodeId() const {
 	case Identifier::Numeric:
 		return UA_NODEID_NUMERIC(m_namespace, m_numeric);
 	case Identifier::String:
-		return UA_NODEID_STRING(m_namespace, m_stringOrByteString->data());
+		// Interned identifiers are never freed, so the UA_NodeId stays valid
+		return UA_NODEID_STRING(m_namespace, const_cast<char*>(m_stringOrByteString->data()));
 	case Identifier::ByteString:
-		return UA_NODEID_BYTESTRING(m_namespace, m_stringOrByteString->data());
+		return UA_NODEID_BYTESTRING(m_namespace, const_cast<char*>(m_stringOrByteString->data()));
 	case Identifier::Guid:
 	default:
 		std::cerr << "Tried to convert to UA for node ID w/ unknown identifier!" << std::endl;
@@ -313,6 +282,22 @@ const NodeId::NumericT& NodeId::getNumeric() const {
 	return m_numeric;
 }
 
+void NodeId::updateHash() {
+	std::size_t h = std::hash<NumericT>()(m_numeric);
+	if (m_stringOrByteString) {
+		h = std::hash<std::string>()(*m_stringOrByteString);
+	}
+	m_hash = h ^ (std::size_t(m_namespace) << 16) ^ (std::size_t(m_identifier) << 8);
+}
+
+const std::string* NodeId::intern(const std::string& str) {
+	// Elements of an unordered_set keep their address on rehashing
+	static std::unordered_set<std::string> pool;
+	static std::mutex mutex;
+	std::lock_guard<std::mutex> lock(mutex);
+	return &*pool.insert(str).first;
+}
+
 NodeId::Const::Const(NodeId& other)
 : Const(const_cast<const NodeId&>(other)) {}
 
@@ -390,6 +375,7 @@ NodeId NodeId::Const::toNodeId() const {
 		id.m_identifier = Identifier::Unknown;
 		id.m_namespace = InvalidNamespace;
 		id.m_numeric = InvalidNumeric;
+		id.updateHash();
 		return id;
 	}
 }
@@ -7,7 +7,8 @@
  * @namespace 
  * @copyright 2017 by Janitza electronics GmbH
  * @date	  24.08.2017
- * @note      This example misses Node-ID Types GUID and  String/ByteString
+ * @note      This example misses Node-ID Type GUID. String/ByteString identifiers are interned,
+ *            so NodeId is trivially copyable and compares them by pointer.
  *
  */
 #ifndef NODEID_HPP_
@@ -22,7 +23,8 @@
 #include <iostream>
 #include <string>
 #include <cstdint>
-#include <memory>
+#include <functional>
+#include <type_traits>
 #include <open62541/types.h>
 
 
@@ -57,8 +59,7 @@ public:
 	 */
 	NodeId();
 
-	NodeId(NodeId& other);
-	NodeId(const NodeId& other);
+	NodeId(const NodeId& other) = default;
 
 	NodeId(NamespaceT namespaceIndex, NumericT numeric);
 
@@ -68,7 +69,7 @@ public:
 	explicit NodeId(UA_NodeId* ua);
 	explicit NodeId(const UA_NodeId* ua);
 
-	NodeId& operator =(const NodeId& other);
+	NodeId& operator =(const NodeId& other) = default;
 	NodeId& operator =(const UA_NodeId& other);
 
 	bool operator ==(const NodeId& other) const;
@@ -118,6 +119,14 @@ public:
 	const Identifier& getIdentifier() const;
 	const NumericT& getNumeric() const;
 
+	/**
+	 * Hash value for unordered containers; equal node IDs have equal hashes.
+	 * It is calculated once on construction.
+	 */
+	std::size_t hash() const {
+		return m_hash;
+	}
+
 private:
 	bool m_valid;
 
@@ -125,9 +134,20 @@ private:
 
 	Identifier m_identifier;
 	NumericT m_numeric;
-	std::shared_ptr<std::string> m_stringOrByteString;
+	/** Interned string or bytestring identifier; never freed, so it may be shared by all copies */
+	const std::string* m_stringOrByteString;
+	std::size_t m_hash;
 
 	bool isIdentifierNull() const;
+	void updateHash();
+
+	/**
+	 * Get the unique instance of a string identifier. Equal identifiers share one instance,
+	 * so they can be compared by pointer.
+	 * @param str Identifier
+	 * @return Pointer to the interned identifier, valid for the lifetime of the program
+	 */
+	static const std::string* intern(const std::string& str);
 
 public:
 	class Const final {
@@ -329,4 +349,15 @@ public:
 	};
 };
 	
+static_assert(std::is_trivially_copyable<NodeId>::value, "NodeId shall be trivially copyable");
+
+namespace std {
+template<>
+struct hash<NodeId> {
+	std::size_t operator()(const NodeId& id) const {
+		return id.hash();
+	}
+};
+}
+
 #endif /* NODEID_HPP_ */
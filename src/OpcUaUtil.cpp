@@ -9,6 +9,46 @@
 
 #include <chrono>
 #include <ctime>
+#include <sstream>
+
+namespace {
+
+void printElement(std::ostream& out, const UA_DataType* type, const void* p) {
+	switch(type->typeKind) {
+	case UA_DATATYPEKIND_BOOLEAN:
+		out << (*(const UA_Boolean*)p ? "true" : "false"); break;
+	case UA_DATATYPEKIND_SBYTE:
+		out << (int)*(const UA_SByte*)p; break;
+	case UA_DATATYPEKIND_BYTE:
+		out << (unsigned)*(const UA_Byte*)p; break;
+	case UA_DATATYPEKIND_INT16:
+		out << *(const UA_Int16*)p; break;
+	case UA_DATATYPEKIND_UINT16:
+		out << *(const UA_UInt16*)p; break;
+	case UA_DATATYPEKIND_INT32:
+	case UA_DATATYPEKIND_ENUM:
+		out << *(const UA_Int32*)p; break;
+	case UA_DATATYPEKIND_UINT32:
+	case UA_DATATYPEKIND_STATUSCODE:
+		out << *(const UA_UInt32*)p; break;
+	case UA_DATATYPEKIND_INT64:
+		out << *(const UA_Int64*)p; break;
+	case UA_DATATYPEKIND_UINT64:
+		out << *(const UA_UInt64*)p; break;
+	case UA_DATATYPEKIND_FLOAT:
+		out << *(const UA_Float*)p; break;
+	case UA_DATATYPEKIND_DOUBLE:
+		out << *(const UA_Double*)p; break;
+	case UA_DATATYPEKIND_STRING:
+		out << "\"" << OpcUaUtil::toString(*(const UA_String*)p) << "\""; break;
+	case UA_DATATYPEKIND_DATETIME:
+		out << "\"" << OpcUaUtil::dateTimeToString(*(const UA_DateTime*)p) << "\""; break;
+	default:
+		out << "null";
+	}
+}
+
+}
 
 OpcUaUtil::OpcUaUtil() {
 }
@@ -26,10 +66,19 @@ const std::string OpcUaUtil::dateTimeToString(const UA_DateTime& t) {
 	seconds s = duration_cast<seconds>(us);
 	std::time_t tm = s.count();
 	char buf[100];
-	strftime(buf, 100, "%a %b %d %T %Y", localtime(&tm));
+	struct tm local;
+	strftime(buf, 100, "%a %b %d %T %Y", localtime_r(&tm, &local)); // reentrant, POSIX-specific!!
 	return std::string(buf);
 }
 
+UA_DateTime OpcUaUtil::unixTimeToDateTime(const int64_t& t) {
+	return (t * UA_DATETIME_SEC) + UA_DATETIME_UNIX_EPOCH;
+}
+
+int64_t OpcUaUtil::dateTimeToUnixTime(const UA_DateTime& t) {
+	return (t - UA_DATETIME_UNIX_EPOCH) / UA_DATETIME_SEC;
+}
+
 bool OpcUaUtil::isPrefix(const std::string& str, const std::string& prefix) {
 	return (std::mismatch(prefix.begin(), prefix.end(), str.begin()).first == prefix.end());
 }
@@ -44,3 +93,23 @@ int OpcUaUtil::getIdSuffix(const std::string& str) {
 	return atoi(sub.c_str());
 }
 
+
+const std::string OpcUaUtil::variantToString(const UA_Variant& value) {
+	if(value.type == nullptr || value.data == nullptr) {
+		return "null";
+	}
+	std::ostringstream out;
+	if(UA_Variant_isScalar(&value)) {
+		printElement(out, value.type, value.data);
+	} else {
+		out << "[";
+		for(size_t i = 0; i < value.arrayLength; i++) {
+			if(i > 0) {
+				out << ", ";
+			}
+			printElement(out, value.type, (const UA_Byte*)value.data + i * value.type->memSize);
+		}
+		out << "]";
+	}
+	return out.str();
+}
@@ -18,8 +18,18 @@ public:
 
 	static const std::string toString(const UA_String& uaStr);
 	static const std::string dateTimeToString(const UA_DateTime& t);
+	static UA_DateTime unixTimeToDateTime(const int64_t& t);
+	static int64_t dateTimeToUnixTime(const UA_DateTime& t);
 	static bool isPrefix(const std::string& str, const std::string& prefix);
 	static int getIdSuffix(const std::string& str);
+
+	/**
+	 * Format the value of a variant for the output (numbers, booleans, strings and times;
+	 * arrays as [a, b, ...]). Values of other types are formatted as null.
+	 * @param value Variant to be formatted
+	 * @return Formatted value
+	 */
+	static const std::string variantToString(const UA_Variant& value);
 };
 
 #endif /* OPCUAUTIL_HPP_ */
@@ -12,9 +12,20 @@
 #include <set>
 #include <vector>
 #include <algorithm>
+#include <cstring>
 
 OpcuaClient::OpcuaClient() :
 	m_client(nullptr)
+	,m_url()
+	,m_output(&std::cout)
+	,m_retryPolicy()
+	,m_monitoredNodes()
+	,m_publishingInterval(0)
+	,m_samplingInterval(-1)
+	,m_dataChangeHandler()
+	,m_eventHandler()
+	,m_subscriptionId(0)
+	,m_rawRecordingPoints(false)
 	,m_customTypes({
 			UA_LookupInfoType,
 			UA_RecordingValueInfoType,
@@ -22,11 +33,13 @@ OpcuaClient::OpcuaClient() :
 			UA_RecordingValueType,
 			UA_ReferenceStatusType,
 			UA_RecordingDataTypeType,
-			UA_RecordingPointType,
-			UA_RecordingExtremalsType
+			UA_RecordingExtremalsType,
+			UA_RecordingPointType
 			})
 	,m_customDataTypes({nullptr, m_customTypes.size(), m_customTypes.data()})
+	,m_rawCustomDataTypes({nullptr, m_customTypes.size() - 1, m_customTypes.data()})
 	,m_nodeIdCache()
+	,m_browseCache()
 	{
 
 }
@@ -44,7 +57,7 @@ bool OpcuaClient::connect(const std::string& url) {
 	m_client = UA_Client_new();
 	UA_ClientConfig *cc = UA_Client_getConfig(m_client);
 	UA_ClientConfig_setDefault(cc);
-	cc->customDataTypes = &m_customDataTypes;
+	cc->customDataTypes = m_rawRecordingPoints ? &m_rawCustomDataTypes : &m_customDataTypes;
 	cc->securityMode = securityMode;
 	cc->securityPolicyUri = securityPolicyUri;
 
@@ -55,111 +68,596 @@ bool OpcuaClient::connect(const std::string& url) {
 		std::cerr << "Connect to " << url << " failed with " << UA_StatusCode_name(retval) << std::endl;
 		return false;
 	}
+	m_url = url;
 	return true;
 }
 
+bool OpcuaClient::reconnect() {
+	if(m_client) {
+		UA_Client_delete(m_client); /* Disconnects the client internally */
+		m_client = nullptr;
+	}
+	m_subscriptionId = 0; // deleted with the session
+	if(m_url.empty() || !connect(m_url)) {
+		return false;
+	}
+	if(m_dataChangeHandler || m_eventHandler) {
+		createSubscription();
+	}
+	return true;
+}
+
+void OpcuaClient::setRawRecordingPoints(const bool& enabled) {
+	m_rawRecordingPoints = enabled;
+}
+
+bool OpcuaClient::getRawRecordingPoints() const {
+	return m_rawRecordingPoints;
+}
+
+void OpcuaClient::setRetryPolicy(const RetryPolicy& policy) {
+	m_retryPolicy = policy;
+}
+
+const OpcuaClient::RetryPolicy& OpcuaClient::getRetryPolicy() const {
+	return m_retryPolicy;
+}
+
+const std::string& OpcuaClient::getUrl() const {
+	return m_url;
+}
+
+void OpcuaClient::setOutput(std::ostream& output) {
+	m_output = &output;
+}
+
+std::ostream& OpcuaClient::output() const {
+	return *m_output;
+}
+
 UA_StatusCode OpcuaClient::clientCall(const NodeId objectId, const NodeId methodId,
 			size_t inputSize, const UA_Variant *input, size_t *outputSize, UA_Variant **output) const {
+	if(!m_client) {
+		return UA_STATUSCODE_BADNOTCONNECTED;
+	}
 	return UA_Client_call(m_client, objectId, methodId, inputSize, input, outputSize, output);
 }
 
-NodeId OpcuaClient::browsePathToNodeId(const NodeId& startingNode, const std::vector<PathElement>& path) {
-	NodeId result;
-	if(path.size() == 0) {
-		std::cerr << "Failed to browse path since length is 0" << std::endl;
-		return result;
-	}
-	/**
-	 * @warn This is a very poor cache implementation, as it has no invalidation algorithm and does *not*
-	 * take care about different startingNode-Values!
+OpcuaClient::CallResult::~CallResult() {
+	if(output) {
+		UA_Array_delete(output, outputSize, &UA_TYPES[UA_TYPES_VARIANT]);
+	}
+}
+
+OpcuaClient::CallResult::CallResult(CallResult&& other) :
+	status(other.status),
+	outputSize(other.outputSize),
+	output(other.output) {
+	other.outputSize = 0;
+	other.output = nullptr;
+}
+
+OpcuaClient::CallResult& OpcuaClient::CallResult::operator=(CallResult&& other) {
+	if(this != &other) {
+		std::swap(status, other.status);
+		std::swap(outputSize, other.outputSize);
+		std::swap(output, other.output);
+	}
+	return *this;
+}
+
+OpcuaClient::ReadResult::~ReadResult() {
+	if(values) {
+		UA_Array_delete(values, size, &UA_TYPES[UA_TYPES_DATAVALUE]);
+	}
+}
+
+OpcuaClient::ReadResult::ReadResult(ReadResult&& other) :
+	status(other.status),
+	size(other.size),
+	values(other.values) {
+	other.size = 0;
+	other.values = nullptr;
+}
+
+OpcuaClient::ReadResult& OpcuaClient::ReadResult::operator=(ReadResult&& other) {
+	if(this != &other) {
+		std::swap(status, other.status);
+		std::swap(size, other.size);
+		std::swap(values, other.values);
+	}
+	return *this;
+}
+
+const UA_Variant* OpcuaClient::ReadResult::getVariant(size_t i) const {
+	if(status != UA_STATUSCODE_GOOD || i >= size) {
+		return nullptr;
+	}
+	if(values[i].hasStatus && values[i].status != UA_STATUSCODE_GOOD) {
+		std::cerr << "Reading attribute failed: " << UA_StatusCode_name(values[i].status) << std::endl;
+		return nullptr;
+	}
+	if(!values[i].hasValue) {
+		return nullptr;
+	}
+	return &values[i].value;
+}
+
+/**
+ * Callback for UA_Client_call_async(). Takes over the output arguments of the response and
+ * fulfills the promise that was passed as userdata.
+ */
+static void asyncCallCallback(UA_Client *client, void *userdata, UA_UInt32 requestId, UA_CallResponse *response) {
+	(void)client;
+	(void)requestId;
+	auto promise = static_cast<std::promise<OpcuaClient::CallResult>*>(userdata);
+	UA_StatusCode status = response->responseHeader.serviceResult;
+	if(status == UA_STATUSCODE_GOOD) {
+		if(response->resultsSize != 1) {
+			status = UA_STATUSCODE_BADUNEXPECTEDERROR;
+		} else {
+			status = response->results[0].statusCode;
+		}
+	}
+	if(status != UA_STATUSCODE_GOOD) {
+		promise->set_value(OpcuaClient::CallResult(status));
+	} else {
+		// Move output arguments out of the response, it is cleared by open62541 after this callback
+		UA_CallMethodResult& result = response->results[0];
+		promise->set_value(OpcuaClient::CallResult(status, result.outputArgumentsSize, result.outputArguments));
+		result.outputArguments = nullptr;
+		result.outputArgumentsSize = 0;
+	}
+	delete promise;
+}
+
+std::future<OpcuaClient::CallResult> OpcuaClient::clientCallAsync(const NodeId objectId, const NodeId methodId,
+			size_t inputSize, const UA_Variant *input) const {
+	if(!m_client) {
+		std::promise<CallResult> failed;
+		failed.set_value(CallResult(UA_STATUSCODE_BADNOTCONNECTED));
+		return failed.get_future();
+	}
+	auto promise = new std::promise<CallResult>();
+	std::future<CallResult> result = promise->get_future();
+	const UA_StatusCode retval = UA_Client_call_async(m_client, objectId, methodId, inputSize, input,
+			asyncCallCallback, promise, nullptr);
+	if(retval != UA_STATUSCODE_GOOD) {
+		promise->set_value(CallResult(retval));
+		delete promise;
+	}
+	return result;
+}
+
+OpcuaClient::CallResult OpcuaClient::await(std::future<CallResult>& result) const {
+	while(result.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+		if(!m_client) {
+			return CallResult(UA_STATUSCODE_BADNOTCONNECTED);
+		}
+		const UA_StatusCode retval = UA_Client_run_iterate(m_client, 10);
+		if(retval != UA_STATUSCODE_GOOD) {
+			std::cerr << "Processing asynchronous responses failed: " << UA_StatusCode_name(retval) << std::endl;
+			return CallResult(retval);
+		}
+	}
+	return result.get();
+}
+
+UA_StatusCode OpcuaClient::runIterate(const uint32_t& timeout) const {
+	if(!m_client) {
+		return UA_STATUSCODE_BADNOTCONNECTED;
+	}
+	return UA_Client_run_iterate(m_client, timeout);
+}
+
+std::vector<UA_StatusCode> OpcuaClient::subscribeDataChanges(const std::vector<NodeId>& nodes, const double& publishingInterval,
+		const DataChangeHandler& handler, const double& samplingInterval) {
+	unsubscribe();
+	m_monitoredNodes = nodes;
+	m_publishingInterval = publishingInterval;
+	m_samplingInterval = samplingInterval;
+	m_dataChangeHandler = handler;
+	return createSubscription();
+}
+
+std::vector<UA_StatusCode> OpcuaClient::subscribeEvents(const std::vector<NodeId>& nodes, const double& publishingInterval,
+		const EventHandler& handler) {
+	unsubscribe();
+	m_monitoredNodes = nodes;
+	m_publishingInterval = publishingInterval;
+	m_eventHandler = handler;
+	return createSubscription();
+}
+
+void OpcuaClient::unsubscribe() {
+	if(m_client && m_subscriptionId != 0) {
+		UA_Client_Subscriptions_deleteSingle(m_client, m_subscriptionId);
+	}
+	m_subscriptionId = 0;
+	m_monitoredNodes.clear();
+	m_dataChangeHandler = nullptr;
+	m_eventHandler = nullptr;
+}
+
+std::vector<UA_StatusCode> OpcuaClient::createSubscription() {
+	std::vector<UA_StatusCode> statuses(m_monitoredNodes.size(), UA_STATUSCODE_BADNOTCONNECTED);
+	if(!m_client || m_monitoredNodes.empty()) {
+		return statuses;
+	}
+	UA_CreateSubscriptionRequest request = UA_CreateSubscriptionRequest_default();
+	request.requestedPublishingInterval = m_publishingInterval;
+	UA_CreateSubscriptionResponse response = UA_Client_Subscriptions_create(m_client, request, this, nullptr, nullptr);
+	if(response.responseHeader.serviceResult != UA_STATUSCODE_GOOD) {
+		std::cerr << "Creating subscription failed: " << UA_StatusCode_name(response.responseHeader.serviceResult) << std::endl;
+		statuses.assign(statuses.size(), response.responseHeader.serviceResult);
+		return statuses;
+	}
+	m_subscriptionId = response.subscriptionId;
+
+	/* Event items select the Time of each event; the handler only needs to know that an
+	 * event occurred. All items share the filter.
 	 */
-	auto it = m_nodeIdCache.find(path);
-	if(it != m_nodeIdCache.end()) {
-		std::cout << "Found nodeId for Browsepath to '"<< path.back().browseName <<"' in cache" << std::endl;
-		return it->second;
+	UA_EventFilter filter;
+	UA_EventFilter_init(&filter);
+	if(m_eventHandler) {
+		filter.selectClauses = (UA_SimpleAttributeOperand*)UA_Array_new(1, &UA_TYPES[UA_TYPES_SIMPLEATTRIBUTEOPERAND]);
+		filter.selectClausesSize = 1;
+		filter.selectClauses[0].typeDefinitionId = UA_NODEID_NUMERIC(0, UA_NS0ID_BASEEVENTTYPE);
+		filter.selectClauses[0].browsePath = (UA_QualifiedName*)UA_Array_new(1, &UA_TYPES[UA_TYPES_QUALIFIEDNAME]);
+		filter.selectClauses[0].browsePathSize = 1;
+		filter.selectClauses[0].browsePath[0] = UA_QUALIFIEDNAME_ALLOC(0, "Time");
+		filter.selectClauses[0].attributeId = UA_ATTRIBUTEID_VALUE;
 	}
-	UA_BrowsePath browsePath;
-	UA_BrowsePath_init(&browsePath);
-	browsePath.startingNode = startingNode;
-	browsePath.relativePath.elements = (UA_RelativePathElement*)UA_Array_new(path.size(), &UA_TYPES[UA_TYPES_RELATIVEPATHELEMENT]);
-	browsePath.relativePath.elementsSize = path.size();
 
-	size_t i = 0;
-	for (const auto p : path) {
-		UA_RelativePathElement *elem = &browsePath.relativePath.elements[i++];
-		elem->referenceTypeId = NodeId(0, p.referenceId);
-		elem->targetName = UA_QUALIFIEDNAME_ALLOC(p.ns, p.browseName.c_str());
+	// All monitored items are created with a single request; the index of the node is the item context
+	std::vector<UA_MonitoredItemCreateRequest> items;
+	std::vector<void*> contexts;
+	std::vector<UA_Client_DataChangeNotificationCallback> callbacks(m_monitoredNodes.size(), dataChangeCallback);
+	std::vector<UA_Client_EventNotificationCallback> eventCallbacks(m_monitoredNodes.size(), eventCallback);
+	std::vector<UA_Client_DeleteMonitoredItemCallback> deleteCallbacks(m_monitoredNodes.size(), nullptr);
+	for(size_t i = 0; i < m_monitoredNodes.size(); i++) {
+		items.push_back(UA_MonitoredItemCreateRequest_default(m_monitoredNodes[i]));
+		if(m_eventHandler) {
+			items.back().itemToMonitor.attributeId = UA_ATTRIBUTEID_EVENTNOTIFIER;
+			items.back().requestedParameters.samplingInterval = 0;
+			items.back().requestedParameters.filter.encoding = UA_EXTENSIONOBJECT_DECODED_NODELETE;
+			items.back().requestedParameters.filter.content.decoded.type = &UA_TYPES[UA_TYPES_EVENTFILTER];
+			items.back().requestedParameters.filter.content.decoded.data = &filter;
+		} else {
+			items.back().requestedParameters.samplingInterval = m_samplingInterval;
+		}
+		items.back().requestedParameters.queueSize = 1;
+		items.back().requestedParameters.discardOldest = true;
+		contexts.push_back(reinterpret_cast<void*>(i));
+	}
+	UA_CreateMonitoredItemsRequest itemsRequest;
+	UA_CreateMonitoredItemsRequest_init(&itemsRequest);
+	itemsRequest.subscriptionId = m_subscriptionId;
+	itemsRequest.timestampsToReturn = UA_TIMESTAMPSTORETURN_SOURCE;
+	itemsRequest.itemsToCreate = items.data();
+	itemsRequest.itemsToCreateSize = items.size();
+	UA_CreateMonitoredItemsResponse itemsResponse = m_eventHandler
+			? UA_Client_MonitoredItems_createEvents(m_client, itemsRequest, contexts.data(), eventCallbacks.data(), deleteCallbacks.data())
+			: UA_Client_MonitoredItems_createDataChanges(m_client, itemsRequest, contexts.data(), callbacks.data(), deleteCallbacks.data());
+	UA_EventFilter_clear(&filter);
+	if(itemsResponse.responseHeader.serviceResult != UA_STATUSCODE_GOOD || itemsResponse.resultsSize != items.size()) {
+		std::cerr << "Creating monitored items failed: " << UA_StatusCode_name(itemsResponse.responseHeader.serviceResult) << std::endl;
+		statuses.assign(statuses.size(), UA_STATUSCODE_BADUNEXPECTEDERROR);
+	} else {
+		for(size_t i = 0; i < itemsResponse.resultsSize; i++) {
+			statuses[i] = itemsResponse.results[i].statusCode;
+		}
 	}
+	UA_CreateMonitoredItemsResponse_clear(&itemsResponse);
+	return statuses;
+}
 
+void OpcuaClient::dataChangeCallback(UA_Client *client, UA_UInt32 subId, void *subContext,
+		UA_UInt32 monId, void *monContext, UA_DataValue *value) {
+	(void)client;
+	(void)subId;
+	(void)monId;
+	OpcuaClient* self = static_cast<OpcuaClient*>(subContext);
+	if(self && self->m_dataChangeHandler && value) {
+		self->m_dataChangeHandler(reinterpret_cast<size_t>(monContext), *value);
+	}
+}
+
+void OpcuaClient::eventCallback(UA_Client *client, UA_UInt32 subId, void *subContext,
+		UA_UInt32 monId, void *monContext, size_t nEventFields, UA_Variant *eventFields) {
+	(void)client;
+	(void)subId;
+	(void)monId;
+	(void)nEventFields;
+	(void)eventFields;
+	OpcuaClient* self = static_cast<OpcuaClient*>(subContext);
+	if(self && self->m_eventHandler) {
+		self->m_eventHandler(reinterpret_cast<size_t>(monContext));
+	}
+}
+
+NodeId OpcuaClient::browsePathToNodeId(const NodeId& startingNode, const std::vector<PathElement>& path) {
+	return browsePathsToNodeIds({{startingNode, path}}).front();
+}
+
+std::vector<NodeId> OpcuaClient::browsePathsToNodeIds(const std::vector<BrowsePath>& paths) {
+	std::vector<NodeId> results(paths.size());
+	std::vector<size_t> missing;   // index of paths not found in cache
+	std::vector<BrowsePath> requests;
+
+	for(size_t p=0; p<paths.size(); p++) {
+		const BrowsePath& path = paths[p];
+		if(path.path.size() == 0) {
+			std::cerr << "Failed to browse path since length is 0" << std::endl;
+			continue;
+		}
+		auto it = m_nodeIdCache.find(path);
+		if(it != m_nodeIdCache.end()) {
+			output() << "Found nodeId for Browsepath to '"<< path.path.back().browseName <<"' in cache" << std::endl;
+			results[p] = it->second;
+			continue;
+		}
+		/* Start at the longest prefix already resolved (e.g. /Objects/Device), so the server
+		 * only has to follow the remaining elements.
+		 */
+		BrowsePath request = path;
+		for(size_t len = path.path.size()-1; len > 0; len--) {
+			BrowsePath prefix = {path.startingNode, std::vector<PathElement>(path.path.begin(), path.path.begin()+len)};
+			auto pit = m_nodeIdCache.find(prefix);
+			if(pit != m_nodeIdCache.end() && !pit->second.isNull()) {
+				request = {pit->second, std::vector<PathElement>(path.path.begin()+len, path.path.end())};
+				break;
+			}
+		}
+		missing.push_back(p);
+		requests.push_back(request);
+	}
+	if(requests.empty()) {
+		return results;
+	}
+	if(!m_client) {
+		// Nothing is cached, so the paths are requested again after a reconnect
+		return results;
+	}
+
+	// Resolve all missing paths with a single request
 	UA_TranslateBrowsePathsToNodeIdsRequest request;
 	UA_TranslateBrowsePathsToNodeIdsRequest_init(&request);
-	request.browsePaths = &browsePath;
-	request.browsePathsSize = 1;
+	request.browsePaths = (UA_BrowsePath*)UA_Array_new(requests.size(), &UA_TYPES[UA_TYPES_BROWSEPATH]);
+	request.browsePathsSize = requests.size();
+	for(size_t r=0; r<requests.size(); r++) {
+		UA_BrowsePath& browsePath = request.browsePaths[r];
+		const UA_NodeId startingNode = requests[r].startingNode;
+		UA_NodeId_copy(&startingNode, &browsePath.startingNode);
+		browsePath.relativePath.elements = (UA_RelativePathElement*)UA_Array_new(requests[r].path.size(), &UA_TYPES[UA_TYPES_RELATIVEPATHELEMENT]);
+		browsePath.relativePath.elementsSize = requests[r].path.size();
+		size_t i = 0;
+		for (const auto& p : requests[r].path) {
+			UA_RelativePathElement *elem = &browsePath.relativePath.elements[i++];
+			elem->referenceTypeId = NodeId(0, p.referenceId);
+			elem->targetName = UA_QUALIFIEDNAME_ALLOC(p.ns, p.browseName.c_str());
+		}
+	}
+
 	UA_TranslateBrowsePathsToNodeIdsResponse response = UA_Client_Service_translateBrowsePathsToNodeIds(m_client, request);
-	if(response.responseHeader.serviceResult == UA_STATUSCODE_GOOD && response.resultsSize == 1) {
-		if(response.results[0].targetsSize == 1) {
-			result = response.results[0].targets[0].targetId.nodeId;
-			//std::cout << "Found node for Browsepath: " << result.namespaceIndex << "," <<  result.identifier.numeric << std::endl;
-		} else {
-			std::cerr << "translateBrowsePathsToNodeIds failed: " << UA_StatusCode_name(response.results[0].statusCode) << std::endl;
+	if(response.responseHeader.serviceResult == UA_STATUSCODE_GOOD && response.resultsSize == requests.size()) {
+		for(size_t r=0; r<requests.size(); r++) {
+			NodeId result;
+			if(response.results[r].targetsSize == 1) {
+				result = response.results[r].targets[0].targetId.nodeId;
+			} else {
+				std::cerr << "translateBrowsePathsToNodeIds for '" << paths[missing[r]].path.back().browseName << "' failed: "
+						<< UA_StatusCode_name(response.results[r].statusCode) << std::endl;
+			}
+			results[missing[r]] = result;
+			m_nodeIdCache.emplace(paths[missing[r]], result); // cache request for later requests
 		}
 	} else {
+		// Results of a failed request are not cached, so they are requested again next time
 		std::cerr << "translateBrowsePathsToNodeIds failed: " << UA_StatusCode_name(response.responseHeader.serviceResult) << std::endl;
 	}
-	UA_BrowsePath_clear(&browsePath);
+	UA_TranslateBrowsePathsToNodeIdsRequest_clear(&request);
 	UA_TranslateBrowsePathsToNodeIdsResponse_clear(&response);
 
-	m_nodeIdCache.emplace(path, result); // cache request for later requests
+	return results;
+}
 
-	return result;
+OpcuaClient::ReadResult OpcuaClient::readAttributes(const std::vector<AttributeRef>& attributes,
+		const UA_TimestampsToReturn& timestamps) const {
+	if(!m_client) {
+		return ReadResult(UA_STATUSCODE_BADNOTCONNECTED);
+	}
+	if(attributes.empty()) {
+		return ReadResult();
+	}
+	UA_DataValue* values = (UA_DataValue*)UA_Array_new(attributes.size(), &UA_TYPES[UA_TYPES_DATAVALUE]);
+	for(size_t offset = 0; offset < attributes.size(); offset += MaxNodesPerRead) {
+		const size_t count = std::min(MaxNodesPerRead, attributes.size() - offset);
+		UA_ReadRequest request;
+		UA_ReadRequest_init(&request);
+		request.timestampsToReturn = timestamps;
+		request.nodesToRead = (UA_ReadValueId*)UA_Array_new(count, &UA_TYPES[UA_TYPES_READVALUEID]);
+		request.nodesToReadSize = count;
+		for(size_t i = 0; i < count; i++) {
+			const UA_NodeId id = attributes[offset + i].nodeId;
+			UA_NodeId_copy(&id, &request.nodesToRead[i].nodeId);
+			request.nodesToRead[i].attributeId = attributes[offset + i].attributeId;
+		}
+		UA_ReadResponse response = UA_Client_Service_read(m_client, request);
+		UA_ReadRequest_clear(&request);
+
+		UA_StatusCode status = response.responseHeader.serviceResult;
+		if(status == UA_STATUSCODE_GOOD && response.resultsSize != count) {
+			status = UA_STATUSCODE_BADUNEXPECTEDERROR;
+		}
+		if(status != UA_STATUSCODE_GOOD) {
+			std::cerr << "Reading " << attributes.size() << " attributes failed: " << UA_StatusCode_name(status) << std::endl;
+			UA_ReadResponse_clear(&response);
+			UA_Array_delete(values, attributes.size(), &UA_TYPES[UA_TYPES_DATAVALUE]);
+			return ReadResult(status);
+		}
+		// Take over the results, so they are not freed with the response
+		memcpy(values + offset, response.results, count * sizeof(UA_DataValue));
+		UA_free(response.results);
+		response.results = nullptr;
+		response.resultsSize = 0;
+		UA_ReadResponse_clear(&response);
+	}
+	return ReadResult(UA_STATUSCODE_GOOD, attributes.size(), values);
 }
 
+const std::unordered_set<uint32_t> OpcuaClient::HierarchicalReferences = {
+		UA_NS0ID_HASCHILD,
+		UA_NS0ID_HASEVENTSOURCE,
+		UA_NS0ID_AGGREGATES,
+		UA_NS0ID_HASCOMPONENT,
+		UA_NS0ID_HASORDEREDCOMPONENT,
+		UA_NS0ID_HASHISTORICALCONFIGURATION,
+		UA_NS0ID_HASPROPERTY,
+		UA_NS0ID_HASSUBTYPE,
+		UA_NS0ID_HASNOTIFIER,
+		UA_NS0ID_ORGANIZES
+};
+
 std::map<std::string, NodeId> OpcuaClient::getHierarichalNodes(const NodeId& nodeId) const {
-	std::map<std::string, NodeId> ret;
-	const std::set<int> hierarchicalReferences = {
-			UA_NS0ID_HASCHILD,
-			UA_NS0ID_HASEVENTSOURCE,
-			UA_NS0ID_AGGREGATES,
-			UA_NS0ID_HASCOMPONENT,
-			UA_NS0ID_HASORDEREDCOMPONENT,
-			UA_NS0ID_HASHISTORICALCONFIGURATION,
-			UA_NS0ID_HASPROPERTY,
-			UA_NS0ID_HASSUBTYPE,
-			UA_NS0ID_HASEVENTSOURCE,
-			UA_NS0ID_HASNOTIFIER,
-			UA_NS0ID_ORGANIZES
-	};
-	UA_BrowseRequest bReq;
-	UA_BrowseRequest_init(&bReq);
-	bReq.requestedMaxReferencesPerNode = 0;
-	bReq.nodesToBrowse = UA_BrowseDescription_new();
-	bReq.nodesToBrowseSize = 1;
-	bReq.nodesToBrowse[0].nodeId = nodeId;
-	bReq.nodesToBrowse[0].resultMask = UA_BROWSERESULTMASK_REFERENCETYPEINFO
-			| UA_BROWSERESULTMASK_BROWSENAME; /* only fetch reference type and browsename */
-	bReq.nodesToBrowse[0].nodeClassMask = 0;
-	UA_BrowseResponse bResp = UA_Client_Service_browse(m_client, bReq);
-	if (bResp.responseHeader.serviceResult != UA_STATUSCODE_GOOD) {
-		std::cerr << "Read attributes of " << NodeId(nodeId).toString()
-				<< " failed: "
-				<< UA_StatusCode_name(bResp.responseHeader.serviceResult)
-				<< std::endl;
-	} else {
-		for (size_t i = 0; i < bResp.resultsSize; ++i) {
-			for (size_t j = 0; j < bResp.results[i].referencesSize; ++j) {
-				UA_ReferenceDescription *ref = &(bResp.results[i].references[j]);
-				if (hierarchicalReferences.find(
-						ref->referenceTypeId.identifier.numeric)
-						!= hierarchicalReferences.end()) {
-					NodeId id(ref->nodeId.nodeId);
-					ret[OpcUaUtil::toString(ref->browseName.name)] = id;
+	auto cached = m_browseCache.find(nodeId);
+	if(cached != m_browseCache.end()) {
+		return cached->second;
+	}
+	return getHierarichalNodes(std::vector<NodeId>{nodeId}).front();
+}
+
+std::vector<std::map<std::string, NodeId>> OpcuaClient::getHierarichalNodes(const std::vector<NodeId>& nodeIds) const {
+	std::vector<std::map<std::string, NodeId>> ret(nodeIds.size());
+	if(!m_client) {
+		return ret;
+	}
+
+	for(size_t offset = 0; offset < nodeIds.size(); offset += MaxNodesPerBrowse) {
+		const size_t count = std::min(MaxNodesPerBrowse, nodeIds.size() - offset);
+		UA_BrowseRequest bReq;
+		UA_BrowseRequest_init(&bReq);
+		bReq.requestedMaxReferencesPerNode = 0;
+		bReq.nodesToBrowse = (UA_BrowseDescription*)UA_Array_new(count, &UA_TYPES[UA_TYPES_BROWSEDESCRIPTION]);
+		bReq.nodesToBrowseSize = count;
+		for(size_t n = 0; n < count; n++) {
+			const UA_NodeId id = nodeIds[offset+n];
+			UA_NodeId_copy(&id, &bReq.nodesToBrowse[n].nodeId);
+			bReq.nodesToBrowse[n].browseDirection = UA_BROWSEDIRECTION_FORWARD;
+			bReq.nodesToBrowse[n].includeSubtypes = true;
+			bReq.nodesToBrowse[n].resultMask = UA_BROWSERESULTMASK_REFERENCETYPEINFO
+					| UA_BROWSERESULTMASK_BROWSENAME; /* only fetch reference type and browsename */
+			bReq.nodesToBrowse[n].nodeClassMask = 0;
+		}
+		UA_BrowseResponse bResp = UA_Client_Service_browse(m_client, bReq);
+		if (bResp.responseHeader.serviceResult != UA_STATUSCODE_GOOD || bResp.resultsSize != count) {
+			std::cerr << "Browsing " << count << " nodes failed: "
+					<< UA_StatusCode_name(bResp.responseHeader.serviceResult)
+					<< std::endl;
+		} else {
+			// Nodes of this request with references left at the server
+			std::vector<size_t> pending;
+			std::vector<UA_ByteString> continuationPoints;
+			for (size_t i = 0; i < bResp.resultsSize; ++i) {
+				addHierarchicalReferences(bResp.results[i], ret[offset+i]);
+				if(bResp.results[i].continuationPoint.length > 0) {
+					pending.push_back(offset+i);
+					continuationPoints.push_back(bResp.results[i].continuationPoint);
 				}
 			}
+			browseNext(pending, continuationPoints, ret);
 		}
+		UA_BrowseRequest_clear(&bReq);
+		UA_BrowseResponse_clear(&bResp);
 	}
-	UA_BrowseRequest_clear(&bReq);
-	UA_BrowseResponse_clear(&bResp);
-
 	return ret;
 }
 
+void OpcuaClient::browseNext(std::vector<size_t> pending, std::vector<UA_ByteString> continuationPoints,
+		std::vector<std::map<std::string, NodeId>>& results) const {
+	if(!m_client) {
+		return;
+	}
+	// Response holding the current continuation points; kept until they were sent
+	UA_BrowseNextResponse nResp;
+	UA_BrowseNextResponse_init(&nResp);
+	while(!pending.empty()) {
+		UA_BrowseNextRequest nReq;
+		UA_BrowseNextRequest_init(&nReq);
+		nReq.releaseContinuationPoints = false;
+		nReq.continuationPoints = continuationPoints.data(); // not owned, detached before clear
+		nReq.continuationPointsSize = continuationPoints.size();
+		UA_BrowseNextResponse resp = UA_Client_Service_browseNext(m_client, nReq);
+
+		if(resp.responseHeader.serviceResult != UA_STATUSCODE_GOOD || resp.resultsSize != pending.size()) {
+			std::cerr << "BrowseNext of " << pending.size() << " nodes failed: "
+					<< UA_StatusCode_name(resp.responseHeader.serviceResult)
+					<< "; results are incomplete!" << std::endl;
+			/* The server only holds a few continuation points per session, so release the
+			 * outstanding ones instead of waiting for them to time out.
+			 */
+			nReq.releaseContinuationPoints = true;
+			UA_BrowseNextResponse released = UA_Client_Service_browseNext(m_client, nReq);
+			UA_BrowseNextResponse_clear(&released);
+			UA_BrowseNextResponse_clear(&resp);
+			nReq.continuationPoints = nullptr;
+			nReq.continuationPointsSize = 0;
+			UA_BrowseNextRequest_clear(&nReq);
+			break;
+		}
+		nReq.continuationPoints = nullptr;
+		nReq.continuationPointsSize = 0;
+		UA_BrowseNextRequest_clear(&nReq);
+		// The previous continuation points were sent and can be released now
+		UA_BrowseNextResponse_clear(&nResp);
+		nResp = resp;
+
+		std::vector<size_t> next;
+		continuationPoints.clear();
+		for(size_t i = 0; i < nResp.resultsSize; ++i) {
+			addHierarchicalReferences(nResp.results[i], results[pending[i]]);
+			if(nResp.results[i].continuationPoint.length > 0) {
+				next.push_back(pending[i]);
+				continuationPoints.push_back(nResp.results[i].continuationPoint);
+			}
+		}
+		pending = next;
+	}
+	UA_BrowseNextResponse_clear(&nResp);
+}
+
+void OpcuaClient::addHierarchicalReferences(const UA_BrowseResult& result, std::map<std::string, NodeId>& nodes) {
+	if(result.statusCode != UA_STATUSCODE_GOOD) {
+		std::cerr << "Browse result is bad: " << UA_StatusCode_name(result.statusCode) << std::endl;
+		return;
+	}
+	for (size_t j = 0; j < result.referencesSize; ++j) {
+		const UA_ReferenceDescription *ref = &(result.references[j]);
+		if (ref->referenceTypeId.namespaceIndex == 0
+				&& ref->referenceTypeId.identifierType == UA_NODEIDTYPE_NUMERIC
+				&& HierarchicalReferences.count(ref->referenceTypeId.identifier.numeric) > 0) {
+			nodes[OpcUaUtil::toString(ref->browseName.name)] = NodeId(ref->nodeId.nodeId);
+		}
+	}
+}
+
+BrowseSnapshot OpcuaClient::browseSubtree(const NodeId& root, const std::vector<std::string>& levels) {
+	BrowseSnapshot snapshot;
+	std::vector<NodeId> current = {root};
+	for(size_t level = 0; !current.empty(); level++) {
+		const auto children = getHierarichalNodes(current);
+		std::vector<NodeId> next;
+		for(size_t i = 0; i < current.size(); i++) {
+			for(const auto& c : children[i]) {
+				if(level < levels.size() && OpcUaUtil::isPrefix(c.first, levels[level])) {
+					next.push_back(c.second);
+				}
+			}
+			snapshot[current[i]] = children[i];
+			m_browseCache[current[i]] = children[i];
+		}
+		current = next;
+	}
+	return snapshot;
+}
+
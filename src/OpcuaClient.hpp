@@ -12,32 +12,126 @@
 #include "CustomUaTypes.hpp"
 
 #include <string>
+#include <ostream>
+#include <iostream>
 #include <map>
+#include <unordered_set>
+#include <unordered_map>
 #include <vector>
+#include <future>
+#include <chrono>
+#include <functional>
 #include <open62541/client_config_default.h>
 #include <open62541/client_highlevel.h>
+#include <open62541/client_highlevel_async.h>
+#include <open62541/client_subscriptions.h>
 
 struct PathElement {
 	uint16_t ns;
 	std::string browseName;
 	uint32_t referenceId;
+	bool operator==(const PathElement& other) const {
+		return ns == other.ns && referenceId == other.referenceId && browseName == other.browseName;
+	}
+};
+
+/**
+ * Relative browse path beginning at a starting node
+ */
+struct BrowsePath {
+	NodeId startingNode;
+	std::vector<PathElement> path;
+	bool operator==(const BrowsePath& other) const {
+		return startingNode == other.startingNode && path == other.path;
+	}
 };
 
-struct CmpPathElement {
-	bool operator()(const std::vector<PathElement> &lhs, const std::vector<PathElement> &rhs) const {
-		if(lhs.size() != rhs.size())
-			return (lhs.size() < rhs.size());
-		for(size_t i=0; i<lhs.size(); i++) {
-			if(lhs[i].ns != rhs[i].ns) return (lhs[i].ns < rhs[i].ns);
-			else if(lhs[i].browseName != rhs[i].browseName) return (lhs[i].browseName < rhs[i].browseName);
-			else if(lhs[i].referenceId != rhs[i].referenceId) return (lhs[i].referenceId < rhs[i].referenceId);
+struct BrowsePathHash {
+	std::size_t operator()(const BrowsePath &p) const {
+		std::size_t h = p.startingNode.hash();
+		for(const auto& e : p.path) {
+			h = h * 31 + (std::hash<std::string>()(e.browseName) ^ (std::size_t(e.ns) << 16) ^ e.referenceId);
 		}
-		return false;
+		return h;
 	}
 };
 
+/**
+ * Hierarchical children (by browse name) of browsed nodes
+ */
+using BrowseSnapshot = std::unordered_map<NodeId, std::map<std::string, NodeId>>;
+
 class OpcuaClient {
 public:
+	/**
+	 * Result of an asynchronous method call. Holds the output arguments and frees them on destruction.
+	 */
+	class CallResult {
+	public:
+		CallResult(const UA_StatusCode& s = UA_STATUSCODE_GOOD, size_t size = 0, UA_Variant* out = nullptr) :
+			status(s), outputSize(size), output(out) {}
+		~CallResult();
+		CallResult(CallResult&& other);
+		CallResult& operator=(CallResult&& other);
+		CallResult(const CallResult&) = delete;
+		CallResult& operator=(const CallResult&) = delete;
+		UA_StatusCode status;
+		size_t outputSize;
+		UA_Variant* output;
+	};
+
+	/**
+	 * Attribute of a node to be read by readAttributes()
+	 */
+	struct AttributeRef {
+		NodeId nodeId;
+		UA_UInt32 attributeId = UA_ATTRIBUTEID_VALUE;
+	};
+
+	/**
+	 * Result of a bulk read. Holds one DataValue per requested attribute and frees them on destruction.
+	 */
+	class ReadResult {
+	public:
+		ReadResult(const UA_StatusCode& s = UA_STATUSCODE_GOOD, size_t size = 0, UA_DataValue* v = nullptr) :
+			status(s), size(size), values(v) {}
+		~ReadResult();
+		ReadResult(ReadResult&& other);
+		ReadResult& operator=(ReadResult&& other);
+		ReadResult(const ReadResult&) = delete;
+		ReadResult& operator=(const ReadResult&) = delete;
+
+		/**
+		 * Get the scalar value of a read attribute
+		 * @param i Index of the attribute in the request
+		 * @return Value; default constructed if the attribute could not be read
+		 */
+		template<typename T>
+		T getValue(size_t i) const;
+
+		/**
+		 * Get the array value of a read attribute
+		 * @param i Index of the attribute in the request
+		 * @return Values; empty if the attribute could not be read
+		 */
+		template<typename T>
+		std::vector<T> getArrayValue(size_t i) const;
+
+		UA_StatusCode status;
+		size_t size;
+		UA_DataValue* values;
+	private:
+		const UA_Variant* getVariant(size_t i) const;
+	};
+
+	/**
+	 * Policy for repeating failed requests
+	 */
+	struct RetryPolicy {
+		unsigned maxRetries = 5;
+		std::chrono::milliseconds initialBackoff = std::chrono::milliseconds(500);
+		std::chrono::milliseconds maxBackoff = std::chrono::milliseconds(30000);
+	};
 
 	OpcuaClient();
 	virtual ~OpcuaClient();
@@ -45,34 +139,266 @@ public:
 	OpcuaClient& operator=(const OpcuaClient&) = delete; // non copyable
 
 	bool connect(const std::string& url);
+
+	/**
+	 * Close the current session (if any) and connect again to the last used URL.
+	 * @return true on success
+	 */
+	bool reconnect();
+	const std::string& getUrl() const;
+
+	/**
+	 * Select whether RecordingPoints are left encoded by the client stack. The ExtensionObjects
+	 * then hold the encoded body, which is walked by RecordedDataDecoder::decodeRecordingPoint(),
+	 * instead of a decoded UA_RecordingPoint. This saves the allocation of the UA_RecordingPoint;
+	 * the stack still copies the bytes of each point once, into the body of the ExtensionObject.
+	 * @note Takes effect on the next connect()
+	 * @param enabled true to leave RecordingPoints encoded
+	 */
+	void setRawRecordingPoints(const bool& enabled);
+	bool getRawRecordingPoints() const;
+
+	void setRetryPolicy(const RetryPolicy& policy);
+	const RetryPolicy& getRetryPolicy() const;
+
+	/**
+	 * Set the stream all read data and informational messages of this client are printed to.
+	 * Defaults to STDOUT.
+	 * @param output Stream to be used; must outlive the client
+	 */
+	void setOutput(std::ostream& output);
+	std::ostream& output() const;
 	UA_StatusCode clientCall(const NodeId objectId, const NodeId methodId,
 			size_t inputSize, const UA_Variant *input, size_t *outputSize, UA_Variant **output) const;
 
+	/**
+	 * Send a method call without waiting for the response. Multiple calls can be in flight at the same time,
+	 * the responses are processed while waiting for one of them with await().
+	 * @note The input arguments are encoded immediately, so they may be freed after this method returns.
+	 * @return Future that is fulfilled when the response is received
+	 */
+	std::future<CallResult> clientCallAsync(const NodeId objectId, const NodeId methodId,
+			size_t inputSize, const UA_Variant *input) const;
+
+	/**
+	 * Process network traffic of the client until the result of an asynchronous call is available.
+	 * Responses of other pending calls received in the meantime fulfill their futures as well.
+	 * @param result Future returned by clientCallAsync()
+	 * @return Result of the call
+	 */
+	CallResult await(std::future<CallResult>& result) const;
+
+	/**
+	 * Process network traffic of the client (responses, keep-alive and renewal of the secure channel).
+	 * Long running sessions must call this regularly while they are idle.
+	 * @param timeout Maximum time to wait for network traffic in milliseconds
+	 * @return OPC-UA Statuscode
+	 */
+	UA_StatusCode runIterate(const uint32_t& timeout) const;
+
+	/**
+	 * Handler for data change notifications; called from runIterate() with the index of the node
+	 * and its new value
+	 */
+	using DataChangeHandler = std::function<void(size_t index, const UA_DataValue& value)>;
+
+	/**
+	 * Create a subscription with a data change monitored item on the value of each node.
+	 * The subscription is created again after reconnect(). An existing subscription is replaced.
+	 * @note The first notification of each item is sent right after its creation.
+	 * @param nodes Nodes to be monitored
+	 * @param publishingInterval Publishing interval in milliseconds
+	 * @param handler Called for every notification
+	 * @param samplingInterval Sampling interval of the items in milliseconds; -1 samples with the publishing interval
+	 * @return Status per node; nodes with a bad status are not monitored
+	 */
+	std::vector<UA_StatusCode> subscribeDataChanges(const std::vector<NodeId>& nodes, const double& publishingInterval,
+			const DataChangeHandler& handler, const double& samplingInterval = -1);
+
+	/**
+	 * Handler for event notifications; called from runIterate() with the index of the node
+	 * that emitted the event
+	 */
+	using EventHandler = std::function<void(size_t index)>;
+
+	/**
+	 * Create a subscription with an event monitored item on each node. Only nodes whose
+	 * EventNotifier attribute has the SubscribeToEvents bit set emit events.
+	 * The subscription is created again after reconnect(). An existing subscription is replaced.
+	 * @param nodes Nodes to be monitored
+	 * @param publishingInterval Publishing interval in milliseconds
+	 * @param handler Called for every event
+	 * @return Status per node; nodes with a bad status are not monitored
+	 */
+	std::vector<UA_StatusCode> subscribeEvents(const std::vector<NodeId>& nodes, const double& publishingInterval,
+			const EventHandler& handler);
+
+	/**
+	 * Delete the subscription created by subscribeDataChanges() or subscribeEvents()
+	 */
+	void unsubscribe();
+
 	NodeId browsePathToNodeId(const NodeId& startingNode, const std::vector<PathElement>& p);
 
+	/**
+	 * Translate multiple browse paths to NodeIds. All paths not found in the cache are resolved
+	 * with a single TranslateBrowsePathsToNodeIds request. Paths whose prefix is already cached
+	 * (e.g. /Objects/Device) are requested relative to the NodeId of the prefix.
+	 * @note The cache has no invalidation, as NodeIds of the device don't change during a session
+	 * @param paths Browse paths to be translated
+	 * @return NodeIds in order of paths; a Null-NodeId for paths that could not be resolved
+	 */
+	std::vector<NodeId> browsePathsToNodeIds(const std::vector<BrowsePath>& paths);
+
+	/**
+	 * Get the hierarchical children of a node by their browse name. Nodes browsed by
+	 * browseSubtree() are served from its snapshot without a request.
+	 * @param nodeId Node to be browsed
+	 * @return Children of the node
+	 */
 	std::map<std::string, NodeId> getHierarichalNodes(const NodeId& nodeId) const;
 
+	/**
+	 * Get the hierarchical children of multiple nodes with a single Browse request (split into
+	 * requests of MaxNodesPerBrowse nodes). Continuation points are followed by BrowseNext
+	 * until all references are read. If BrowseNext fails, the outstanding continuation points
+	 * are released at the server.
+	 * @param nodeIds Nodes to be browsed
+	 * @return Children of the nodes in order of nodeIds
+	 */
+	std::vector<std::map<std::string, NodeId>> getHierarichalNodes(const std::vector<NodeId>& nodeIds) const;
+
+	/**
+	 * Browse a subtree level by level, all nodes of a level with one request.
+	 * The result is kept as snapshot for later calls of getHierarichalNodes().
+	 * @param root Node to start with
+	 * @param levels Browse name prefix of the children to descend into for each level, e.g.
+	 *        {"Recording", "RecordingConfiguration"} for /Recordings/RecordingN/RecordingConfigurationM
+	 * @return Children of all browsed nodes
+	 */
+	BrowseSnapshot browseSubtree(const NodeId& root, const std::vector<std::string>& levels);
+
+	/**
+	 * Read any number of attributes of any nodes with a single Read request (split into
+	 * requests of MaxNodesPerRead attributes)
+	 * @param attributes Attributes to be read
+	 * @param timestamps Timestamps to be returned with the values
+	 * @return Values in order of attributes; the status is the service result
+	 */
+	ReadResult readAttributes(const std::vector<AttributeRef>& attributes,
+			const UA_TimestampsToReturn& timestamps = UA_TIMESTAMPSTORETURN_NEITHER) const;
+
 	template<typename T>
 	const T getVariantValue(const NodeId& nodeId) const;
 	template<typename T>
 	std::vector<T> getVariantArrayValue(const NodeId& nodeId) const;
 
 private:
+	/**
+	 * Maximum number of nodes per Browse request
+	 */
+	static constexpr size_t MaxNodesPerBrowse = 500;
+
+	/**
+	 * Maximum number of attributes per Read request
+	 */
+	static constexpr size_t MaxNodesPerRead = 1000;
+
+	/**
+	 * Numeric ids of the reference types (namespace 0) followed by getHierarichalNodes()
+	 */
+	static const std::unordered_set<uint32_t> HierarchicalReferences;
+
+	void browseNext(std::vector<size_t> pending, std::vector<UA_ByteString> continuationPoints,
+			std::vector<std::map<std::string, NodeId>>& results) const;
+	static void addHierarchicalReferences(const UA_BrowseResult& result, std::map<std::string, NodeId>& nodes);
+	std::vector<UA_StatusCode> createSubscription();
+	static void dataChangeCallback(UA_Client *client, UA_UInt32 subId, void *subContext,
+			UA_UInt32 monId, void *monContext, UA_DataValue *value);
+	static void eventCallback(UA_Client *client, UA_UInt32 subId, void *subContext,
+			UA_UInt32 monId, void *monContext, size_t nEventFields, UA_Variant *eventFields);
+
 	UA_Client* m_client;
+	std::string m_url;
+	std::ostream* m_output;
+	RetryPolicy m_retryPolicy;
+	std::vector<NodeId> m_monitoredNodes;
+	double m_publishingInterval;
+	double m_samplingInterval;
+	DataChangeHandler m_dataChangeHandler;
+	EventHandler m_eventHandler;
+	UA_UInt32 m_subscriptionId;
+	bool m_rawRecordingPoints;
+	/** UA_RecordingPointType is the last custom type, so it can be left out */
 	std::vector<UA_DataType> m_customTypes;
 	UA_DataTypeArray m_customDataTypes;
-	std::map<std::vector<PathElement>,NodeId, CmpPathElement> m_nodeIdCache;
+	UA_DataTypeArray m_rawCustomDataTypes;
+
+protected:
+	/** Caches of resolved browse paths and browsed nodes; may be restored from a metadata snapshot */
+	std::unordered_map<BrowsePath, NodeId, BrowsePathHash> m_nodeIdCache;
+	BrowseSnapshot m_browseCache;
 };
 
+/**
+ * Convert a scalar variant to a value of type T
+ */
+template<typename T>
+	T variantToValue(const UA_Variant& val) {
+	T ret = T();
+	if(val.type == nullptr || val.data == nullptr) {
+		return ret;
+	}
+	if(val.type->typeKind == UA_DATATYPEKIND_EXTENSIONOBJECT) {
+		std::cerr << "Unknown type!" << std::endl;
+	}
+	ret = *(T*)val.data;
+	return ret;
+}
+
+/**
+ * Convert an array variant to values of type T; decoded ExtensionObjects are unpacked
+ */
+template<typename T>
+	std::vector<T> variantToArray(const UA_Variant& val) {
+	std::vector<T> ret;
+	if(!UA_Variant_isScalar(&val)) {
+		if(val.type->typeKind == UA_DATATYPEKIND_EXTENSIONOBJECT) {
+			UA_ExtensionObject* e = (UA_ExtensionObject*)val.data;
+			for(size_t i=0; i < val.arrayLength; i++) {
+				if(e[i].encoding < UA_EXTENSIONOBJECT_DECODED) {
+					std::cerr << "Unknown type!" << std::endl;
+				} else {
+					ret.emplace_back(*(T*)e[i].content.decoded.data);
+				}
+			}
+		} else {
+			ret.assign((T*)val.data, ((T*)val.data) + val.arrayLength);
+		}
+	} else {
+		std::cerr << "No array data!" << std::endl;
+	}
+	return ret;
+}
+
+template<typename T>
+	T OpcuaClient::ReadResult::getValue(size_t i) const {
+	const UA_Variant* val = getVariant(i);
+	return val ? variantToValue<T>(*val) : T();
+}
+
+template<typename T>
+	std::vector<T> OpcuaClient::ReadResult::getArrayValue(size_t i) const {
+	const UA_Variant* val = getVariant(i);
+	return val ? variantToArray<T>(*val) : std::vector<T>();
+}
+
 template<typename T>
 	const T OpcuaClient::getVariantValue(const NodeId& nodeId) const {
 	T ret = T();
 	UA_Variant *val = UA_Variant_new();
-	if(UA_Client_readValueAttribute(m_client, nodeId, val) == UA_STATUSCODE_GOOD) {
-		if(val->type->typeKind == UA_DATATYPEKIND_EXTENSIONOBJECT) {
-			std::cerr << "Unknown type!" << std::endl;
-		}
-		ret = *(T*)val->data;
+	if(m_client && UA_Client_readValueAttribute(m_client, nodeId, val) == UA_STATUSCODE_GOOD) {
+		ret = variantToValue<T>(*val);
 	}
 	UA_Variant_delete(val);
 	return ret;
@@ -82,23 +408,8 @@ template<typename T>
 	std::vector<T> OpcuaClient::getVariantArrayValue(const NodeId& nodeId) const {
 	std::vector<T> ret;
 	UA_Variant *val = UA_Variant_new();
-	if(UA_Client_readValueAttribute(m_client, nodeId, val) == UA_STATUSCODE_GOOD) {
-		if(!UA_Variant_isScalar(val)) {
-			if(val->type->typeKind == UA_DATATYPEKIND_EXTENSIONOBJECT) {
-				UA_ExtensionObject* e = (UA_ExtensionObject*)val->data;
-				for(size_t i=0; i < val->arrayLength; i++) {
-					if(e[i].encoding < UA_EXTENSIONOBJECT_DECODED) {
-						std::cerr << "Unknown type!" << std::endl;
-					} else {
-						ret.emplace_back(*(T*)e[i].content.decoded.data);
-					}
-				}
-			} else {
-				ret.assign((T*)val->data, ((T*)val->data) + val->arrayLength);
-			}
-		} else {
-			std::cerr << "No array data!" << std::endl;
-		}
+	if(m_client && UA_Client_readValueAttribute(m_client, nodeId, val) == UA_STATUSCODE_GOOD) {
+		ret = variantToArray<T>(*val);
 	}
 	UA_Variant_delete(val);
 	return ret;
@@ -0,0 +1,383 @@
+/*
+ * RecordedDataDecoder.cpp
+ *
+ *  Created on: 17.10.2026
+ *   Copyright: 2026 by Janitza electronics GmbH
+ */
+
+#include "RecordedDataDecoder.hpp"
+
+#include <cstring>
+#include <algorithm>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+enum WireType : uint32_t {
+	WIRETYPE_VARINT = 0,
+	WIRETYPE_FIXED64 = 1,
+	WIRETYPE_LENGTH_DELIMITED = 2,
+	WIRETYPE_FIXED32 = 5
+};
+
+/** A varint takes at most 10 bytes */
+constexpr unsigned MaxVarintLength = 10;
+
+bool readVarint(const uint8_t*& p, const uint8_t* end, uint64_t& value) {
+	value = 0;
+	for(unsigned shift = 0; p < end && shift < 7 * MaxVarintLength; shift += 7) {
+		const uint8_t b = *p++;
+		value |= uint64_t(b & 0x7f) << shift;
+		if(!(b & 0x80)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool readLength(const uint8_t*& p, const uint8_t* end, const uint8_t*& fieldEnd) {
+	uint64_t length;
+	if(!readVarint(p, end, length) || length > uint64_t(end - p)) {
+		return false;
+	}
+	fieldEnd = p + length;
+	return true;
+}
+
+bool skipField(const uint32_t& wireType, const uint8_t*& p, const uint8_t* end) {
+	uint64_t value;
+	const uint8_t* fieldEnd;
+	switch(wireType) {
+	case WIRETYPE_VARINT:
+		return readVarint(p, end, value);
+	case WIRETYPE_FIXED64:
+		if(end - p < 8) return false;
+		p += 8;
+		return true;
+	case WIRETYPE_LENGTH_DELIMITED:
+		if(!readLength(p, end, fieldEnd)) return false;
+		p = fieldEnd;
+		return true;
+	case WIRETYPE_FIXED32:
+		if(end - p < 4) return false;
+		p += 4;
+		return true;
+	default:
+		// Groups are not used by records.proto
+		return false;
+	}
+}
+
+/*
+ * Conversion of a varint to the value of a column
+ */
+template<typename T>
+struct Varint {
+	static T convert(const uint64_t& v) { return static_cast<T>(v); }
+};
+template<>
+struct Varint<int32_t> { // sint32
+	static int32_t convert(const uint64_t& v) { const uint32_t n = v; return (n >> 1) ^ -int32_t(n & 1); }
+};
+template<>
+struct Varint<int64_t> { // sint64
+	static int64_t convert(const uint64_t& v) { return (v >> 1) ^ -int64_t(v & 1); }
+};
+template<>
+struct Varint<bool> {
+	static uint8_t convert(const uint64_t& v) { return v != 0; }
+};
+/** Timestamps are plain int64 */
+struct Timestamp {
+	static int64_t convert(const uint64_t& v) { return static_cast<int64_t>(v); }
+};
+
+/*
+ * Decode the packed varints between p and end and append them to a column.
+ * With SSE2 16 bytes are examined at once: the bytes without continuation bit terminate a
+ * varint, so all varints ending within the 16 bytes are found from a single mask.
+ */
+template<typename Convert, typename V>
+bool readVarints(const uint8_t* p, const uint8_t* end, std::vector<V>& column) {
+	const size_t first = column.size();
+	// Every varint takes at least one byte
+	column.resize(first + (end - p));
+	V* out = column.data() + first;
+#ifdef __SSE2__
+	while(end - p >= 16) {
+		const unsigned stops = ~_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))) & 0xffff;
+		if(stops == 0xffff) {
+			// 16 single byte varints
+			for(unsigned i = 0; i < 16; i++) {
+				out[i] = Convert::convert(p[i]);
+			}
+			out += 16;
+			p += 16;
+			continue;
+		}
+		if(stops == 0) {
+			return false;
+		}
+		unsigned begin = 0;
+		for(unsigned s = stops; s != 0; s &= s - 1) {
+			const unsigned stop = __builtin_ctz(s);
+			if(stop - begin >= MaxVarintLength) {
+				return false;
+			}
+			uint64_t v = 0;
+			for(unsigned i = begin; i <= stop; i++) {
+				v |= uint64_t(p[i] & 0x7f) << (7 * (i - begin));
+			}
+			*out++ = Convert::convert(v);
+			begin = stop + 1;
+		}
+		p += begin;
+	}
+#endif
+	while(p < end) {
+		uint64_t v;
+		if(!readVarint(p, end, v)) {
+			return false;
+		}
+		*out++ = Convert::convert(v);
+	}
+	column.resize(out - column.data());
+	return true;
+}
+
+/*
+ * Append little endian fixed size values to a column
+ */
+template<typename V>
+bool readFixed(const uint8_t* p, const uint8_t* end, std::vector<V>& column) {
+	const size_t length = end - p;
+	if(length % sizeof(V) != 0) {
+		return false;
+	}
+	const size_t first = column.size();
+	column.resize(first + length / sizeof(V));
+	memcpy(column.data() + first, p, length);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	for(size_t i = first; i < column.size(); i++) {
+		uint8_t* b = reinterpret_cast<uint8_t*>(&column[i]);
+		std::reverse(b, b + sizeof(V));
+	}
+#endif
+	return true;
+}
+
+/*
+ * Read a repeated field, which may be packed or not
+ */
+template<typename T, typename Convert, typename V>
+bool readRepeated(const uint32_t& wireType, const uint8_t*& p, const uint8_t* end, std::vector<V>& column) {
+	const uint8_t* fieldEnd;
+	if constexpr(std::is_floating_point<T>::value) {
+		constexpr uint32_t ScalarType = (sizeof(T) == 8) ? WIRETYPE_FIXED64 : WIRETYPE_FIXED32;
+		if(wireType == WIRETYPE_LENGTH_DELIMITED) {
+			if(!readLength(p, end, fieldEnd) || !readFixed(p, fieldEnd, column)) return false;
+		} else if(wireType == ScalarType) {
+			if(size_t(end - p) < sizeof(T)) return false;
+			fieldEnd = p + sizeof(T);
+			readFixed(p, fieldEnd, column);
+		} else {
+			return skipField(wireType, p, end);
+		}
+	} else {
+		if(wireType == WIRETYPE_LENGTH_DELIMITED) {
+			if(!readLength(p, end, fieldEnd) || !readVarints<Convert>(p, fieldEnd, column)) return false;
+		} else if(wireType == WIRETYPE_VARINT) {
+			uint64_t v;
+			if(!readVarint(p, end, v)) return false;
+			column.push_back(Convert::convert(v));
+			fieldEnd = p;
+		} else {
+			return skipField(wireType, p, end);
+		}
+	}
+	p = fieldEnd;
+	return true;
+}
+
+/*
+ * Decode a RecordedXxxTuple message and append its values to the columns
+ */
+template<typename T>
+bool decodeTuple(const uint8_t* p, const uint8_t* end, RecordedTuple<T>& tuple) {
+	using Convert = Varint<T>;
+	while(p < end) {
+		uint64_t tag;
+		if(!readVarint(p, end, tag)) {
+			return false;
+		}
+		const uint32_t wireType = tag & 7;
+		bool ok;
+		switch(tag >> 3) {
+		case 1: ok = readRepeated<T, Convert>(wireType, p, end, tuple.samples); break;
+		case 2: ok = readRepeated<T, Convert>(wireType, p, end, tuple.avgValues); break;
+		case 3: ok = readRepeated<T, Convert>(wireType, p, end, tuple.minValues); break;
+		case 4: ok = readRepeated<int64_t, Timestamp>(wireType, p, end, tuple.minTimestamps); break;
+		case 5: ok = readRepeated<T, Convert>(wireType, p, end, tuple.maxValues); break;
+		case 6: ok = readRepeated<int64_t, Timestamp>(wireType, p, end, tuple.maxTimestamps); break;
+		default: ok = skipField(wireType, p, end);
+		}
+		if(!ok) {
+			return false;
+		}
+	}
+	return true;
+}
+
+template<typename T, typename P>
+void copyTuple(const P& protobuf, RecordedTuple<T>& tuple) {
+	tuple.samples.assign(protobuf.sample().begin(), protobuf.sample().end());
+	tuple.avgValues.assign(protobuf.avgvalue().begin(), protobuf.avgvalue().end());
+	tuple.minValues.assign(protobuf.minvalue().begin(), protobuf.minvalue().end());
+	tuple.minTimestamps.assign(protobuf.mintimestamp().begin(), protobuf.mintimestamp().end());
+	tuple.maxValues.assign(protobuf.maxvalue().begin(), protobuf.maxvalue().end());
+	tuple.maxTimestamps.assign(protobuf.maxtimestamp().begin(), protobuf.maxtimestamp().end());
+}
+
+template<typename V>
+bool sameBits(const std::vector<V>& a, const std::vector<V>& b) {
+	return a.size() == b.size() && (a.empty() || memcmp(a.data(), b.data(), a.size() * sizeof(V)) == 0);
+}
+
+}
+
+template<typename T>
+void RecordedTuple<T>::clear() {
+	samples.clear();
+	avgValues.clear();
+	minValues.clear();
+	minTimestamps.clear();
+	maxValues.clear();
+	maxTimestamps.clear();
+}
+
+template<typename T>
+bool RecordedTuple<T>::operator==(const RecordedTuple& other) const {
+	return sameBits(samples, other.samples) && sameBits(avgValues, other.avgValues)
+			&& sameBits(minValues, other.minValues) && sameBits(minTimestamps, other.minTimestamps)
+			&& sameBits(maxValues, other.maxValues) && sameBits(maxTimestamps, other.maxTimestamps);
+}
+
+template struct RecordedTuple<double>;
+template struct RecordedTuple<float>;
+template struct RecordedTuple<uint32_t>;
+template struct RecordedTuple<int32_t>;
+template struct RecordedTuple<uint64_t>;
+template struct RecordedTuple<int64_t>;
+template struct RecordedTuple<bool>;
+
+void RecordedColumns::clear() {
+	startTimeUtc = 0;
+	doubles.clear();
+	floats.clear();
+	uint32s.clear();
+	sint32s.clear();
+	uint64s.clear();
+	sint64s.clear();
+	bools.clear();
+}
+
+bool RecordedColumns::operator==(const RecordedColumns& other) const {
+	return startTimeUtc == other.startTimeUtc && doubles == other.doubles && floats == other.floats
+			&& uint32s == other.uint32s && sint32s == other.sint32s && uint64s == other.uint64s
+			&& sint64s == other.sint64s && bools == other.bools;
+}
+
+bool RecordedDataDecoder::decode(const uint8_t* data, const size_t& length, RecordedColumns& point) {
+	point.clear();
+	const uint8_t* p = data;
+	const uint8_t* const end = data + length;
+	while(p < end) {
+		uint64_t tag;
+		if(!readVarint(p, end, tag)) {
+			return false;
+		}
+		const uint32_t wireType = tag & 7;
+		const uint32_t field = tag >> 3;
+		if(field == 1 && wireType == WIRETYPE_VARINT) {
+			uint64_t v;
+			if(!readVarint(p, end, v)) {
+				return false;
+			}
+			point.startTimeUtc = static_cast<int64_t>(v);
+			continue;
+		}
+		if(field < 2 || field > 8 || wireType != WIRETYPE_LENGTH_DELIMITED) {
+			if(!skipField(wireType, p, end)) {
+				return false;
+			}
+			continue;
+		}
+		const uint8_t* fieldEnd;
+		if(!readLength(p, end, fieldEnd)) {
+			return false;
+		}
+		bool ok = false;
+		switch(field) {
+		case 2: ok = decodeTuple(p, fieldEnd, point.doubles); break;
+		case 3: ok = decodeTuple(p, fieldEnd, point.floats); break;
+		case 4: ok = decodeTuple(p, fieldEnd, point.uint32s); break;
+		case 5: ok = decodeTuple(p, fieldEnd, point.sint32s); break;
+		case 6: ok = decodeTuple(p, fieldEnd, point.uint64s); break;
+		case 7: ok = decodeTuple(p, fieldEnd, point.sint64s); break;
+		case 8: ok = decodeTuple(p, fieldEnd, point.bools); break;
+		}
+		if(!ok) {
+			return false;
+		}
+		p = fieldEnd;
+	}
+	return true;
+}
+
+void RecordedDataDecoder::fromProtobuf(const records::RecordedData& protobuf, RecordedColumns& point) {
+	point.clear();
+	point.startTimeUtc = protobuf.starttimeutc();
+	copyTuple(protobuf.double_(), point.doubles);
+	copyTuple(protobuf.float_(), point.floats);
+	copyTuple(protobuf.uint32(), point.uint32s);
+	copyTuple(protobuf.sint32(), point.sint32s);
+	copyTuple(protobuf.uint64(), point.uint64s);
+	copyTuple(protobuf.sint64(), point.sint64s);
+	copyTuple(protobuf.bool_(), point.bools);
+}
+
+bool RecordedDataDecoder::verify(const uint8_t* data, const size_t& length, const RecordedColumns& point) {
+	// Parsing into the same message again reuses the memory of its repeated fields
+	thread_local records::RecordedData protobuf;
+	thread_local RecordedColumns expected;
+	if(!protobuf.ParseFromArray(data, length)) {
+		return false;
+	}
+	fromProtobuf(protobuf, expected);
+	return expected == point;
+}
+
+bool RecordedDataDecoder::decodeRecordingPoint(const uint8_t* body, const size_t& length, RecordingPointView& point) {
+	// OPC UA binary encoding is little endian
+	auto readUInt32 = [](const uint8_t* p) {
+		return uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 | uint32_t(p[3]) << 24;
+	};
+	if(length < 8) {
+		return false;
+	}
+	point.configId = readUInt32(body);
+	const int32_t dataLength = static_cast<int32_t>(readUInt32(body + 4));
+	if(dataLength < 0) {
+		point.data = nullptr;
+		point.length = 0;
+		return dataLength == -1;
+	}
+	if(size_t(dataLength) > length - 8) {
+		return false;
+	}
+	point.data = body + 8;
+	point.length = dataLength;
+	return true;
+}
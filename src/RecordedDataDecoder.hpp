@@ -0,0 +1,134 @@
+/*
+ * RecordedDataDecoder.hpp
+ *
+ *  Created on: 17.10.2026
+ *   Copyright: 2026 by Janitza electronics GmbH
+ */
+
+#ifndef RECORDEDDATADECODER_HPP_
+#define RECORDEDDATADECODER_HPP_
+
+#include "records.pb.h"
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <type_traits>
+
+/**
+ * Columns of one type of a recording point (see RecordedXxxTuple in records.proto).
+ * The accessors mirror those of the generated protobuf classes, so code decoding the values
+ * works on both.
+ */
+template<typename T>
+struct RecordedTuple {
+	/** Booleans are stored as bytes, so the columns are plain arrays */
+	using Value = typename std::conditional<std::is_same<T, bool>::value, uint8_t, T>::type;
+
+	std::vector<Value> samples;
+	std::vector<Value> avgValues;
+	std::vector<Value> minValues;
+	std::vector<int64_t> minTimestamps;
+	std::vector<Value> maxValues;
+	std::vector<int64_t> maxTimestamps;
+
+	const std::vector<Value>& sample() const { return samples; }
+	const std::vector<Value>& avgvalue() const { return avgValues; }
+	Value minvalue(int i) const { return minValues[i]; }
+	int64_t mintimestamp(int i) const { return minTimestamps[i]; }
+	Value maxvalue(int i) const { return maxValues[i]; }
+	int64_t maxtimestamp(int i) const { return maxTimestamps[i]; }
+	int sample_size() const { return samples.size(); }
+	int avgvalue_size() const { return avgValues.size(); }
+	int minvalue_size() const { return minValues.size(); }
+	int mintimestamp_size() const { return minTimestamps.size(); }
+	int maxvalue_size() const { return maxValues.size(); }
+	int maxtimestamp_size() const { return maxTimestamps.size(); }
+
+	/** Empty all columns, keeping their memory */
+	void clear();
+	/** Bitwise comparison of all columns */
+	bool operator==(const RecordedTuple& other) const;
+};
+
+/**
+ * Decoded recording point (see RecordedData in records.proto) held in column buffers.
+ * The buffers are meant to be reused for multiple points.
+ */
+struct RecordedColumns {
+	int64_t startTimeUtc = 0;
+	RecordedTuple<double> doubles;
+	RecordedTuple<float> floats;
+	RecordedTuple<uint32_t> uint32s;
+	RecordedTuple<int32_t> sint32s;
+	RecordedTuple<uint64_t> uint64s;
+	RecordedTuple<int64_t> sint64s;
+	RecordedTuple<bool> bools;
+
+	int64_t starttimeutc() const { return startTimeUtc; }
+	const RecordedTuple<double>& double_() const { return doubles; }
+	const RecordedTuple<float>& float_() const { return floats; }
+	const RecordedTuple<uint32_t>& uint32() const { return uint32s; }
+	const RecordedTuple<int32_t>& sint32() const { return sint32s; }
+	const RecordedTuple<uint64_t>& uint64() const { return uint64s; }
+	const RecordedTuple<int64_t>& sint64() const { return sint64s; }
+	const RecordedTuple<bool>& bool_() const { return bools; }
+
+	void clear();
+	bool operator==(const RecordedColumns& other) const;
+};
+
+/**
+ * RecordingPoint (see UA_RecordingPoint in CustomUaTypes.hpp) whose data refers to the
+ * memory of a received response instead of a copy
+ */
+struct RecordingPointView {
+	uint32_t configId = 0;
+	const uint8_t* data = nullptr;
+	size_t length = 0;
+};
+
+/**
+ * Decoder of the protobuf wire format of records::RecordedData into RecordedColumns.
+ * Packed repeated fields are read directly into the columns without building the generated
+ * messages first. Runs of varints are decoded with SSE2, if available.
+ */
+class RecordedDataDecoder {
+public:
+	/**
+	 * Decode a serialized RecordedData message
+	 * @param data Serialized message
+	 * @param length Length of the message in bytes
+	 * @param point Output parameter; cleared and filled with the decoded point
+	 * @return false if the message is malformed
+	 */
+	static bool decode(const uint8_t* data, const size_t& length, RecordedColumns& point);
+
+	/**
+	 * Copy a message decoded by the protobuf library into columns
+	 * @param protobuf Decoded message
+	 * @param point Output parameter; cleared and filled with the values of the message
+	 */
+	static void fromProtobuf(const records::RecordedData& protobuf, RecordedColumns& point);
+
+	/**
+	 * Decode a message with the protobuf library and compare the result with a point decoded by decode()
+	 * @param data Serialized message
+	 * @param length Length of the message in bytes
+	 * @param point Point decoded from the same message
+	 * @return true if both decoders yield the same values bit by bit
+	 */
+	static bool verify(const uint8_t* data, const size_t& length, const RecordedColumns& point);
+
+	/**
+	 * Walk the binary encoded body of a RecordingPoint ExtensionObject: UInt32 configId followed by
+	 * the ByteString data (Int32 length, -1 for null, and the bytes)
+	 * @param body Encoded body
+	 * @param length Length of the body in bytes
+	 * @param point Output parameter; its data points into body
+	 * @return false if the body is malformed
+	 */
+	static bool decodeRecordingPoint(const uint8_t* body, const size_t& length, RecordingPointView& point);
+};
+
+#endif /* RECORDEDDATADECODER_HPP_ */
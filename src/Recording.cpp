@@ -7,11 +7,15 @@
 
 #include "Recording.hpp"
 #include "Umg801.hpp"
+#include "DecodePlan.hpp"
 
 #include <iostream>
 #include <iomanip>
 #include <chrono>
 #include <ctime>
+#include <thread>
+#include <algorithm>
+#include <cstdint>
 
 Recording::Recording(Umg801& client, const uint32_t& id, const NodeId& nodeId) :
 	m_client(client),
@@ -21,8 +25,19 @@ Recording::Recording(Umg801& client, const uint32_t& id, const NodeId& nodeId) :
 	m_getRangeId(),
 	m_countByRangeId(),
 	m_readByStartAndCountIdId(),
-	m_configIds() {}
+	m_configIds(),
+	m_configs() {}
 
+Recording::Recording(Umg801& client, const Recording& other) :
+	m_client(client),
+	m_id(other.m_id),
+	m_nodeId(other.m_nodeId),
+	m_dataId(other.m_dataId),
+	m_getRangeId(other.m_getRangeId),
+	m_countByRangeId(other.m_countByRangeId),
+	m_readByStartAndCountIdId(other.m_readByStartAndCountIdId),
+	m_configIds(other.m_configIds),
+	m_configs(other.m_configs) {}
 
 UA_StatusCode Recording::getNodeIds() {
 	auto recordChilds = m_client.getHierarichalNodes(m_nodeId);
@@ -37,37 +52,40 @@ UA_StatusCode Recording::getNodeIds() {
 			m_configIds.emplace(OpcUaUtil::getIdSuffix(c.first),c.second);
 		}
 	}
-	m_getRangeId = m_client.browsePathToNodeId(NodeId(0,UA_NS0ID_BASEOBJECTTYPE),
-			{{2,"RecordingType", UA_NS0ID_HASSUBTYPE},
-			 {2,"Data", UA_NS0ID_HASCOMPONENT},
-			 {2,"GetRange", UA_NS0ID_HASCOMPONENT}});
-	if(m_getRangeId.isNull()) {
-		std::cerr << "Node BaseObjectType/RecordingType/Data/GetRange not found!" << std::endl;
-		return UA_STATUSCODE_BADINTERNALERROR;
-	}
-	m_countByRangeId = m_client.browsePathToNodeId(NodeId(0,UA_NS0ID_BASEOBJECTTYPE),
-			{{2,"RecordingType", UA_NS0ID_HASSUBTYPE},
-			 {2,"Data", UA_NS0ID_HASCOMPONENT},
-			 {2,"CountByRange", UA_NS0ID_HASCOMPONENT}});
-	if(m_countByRangeId.isNull()) {
-		std::cerr << "Node BaseObjectType/RecordingType/Data/CountByRange not found!" << std::endl;
-		return UA_STATUSCODE_BADINTERNALERROR;
+	// The method nodes are shared by all recordings, so they are resolved with one request
+	const std::vector<BrowsePath> paths = getMethodPaths();
+	const std::vector<NodeId> methodIds = m_client.browsePathsToNodeIds(paths);
+	for(size_t i=0; i<methodIds.size(); i++) {
+		if(methodIds[i].isNull()) {
+			std::cerr << "Node BaseObjectType/RecordingType/Data/" << paths[i].path.back().browseName << " not found!" << std::endl;
+			return UA_STATUSCODE_BADINTERNALERROR;
+		}
 	}
-	m_readByStartAndCountIdId = m_client.browsePathToNodeId(NodeId(0, UA_NS0ID_BASEOBJECTTYPE),
+	m_getRangeId = methodIds[0];
+	m_countByRangeId = methodIds[1];
+	m_readByStartAndCountIdId = methodIds[2];
+	return UA_STATUSCODE_GOOD;
+}
+
+std::vector<BrowsePath> Recording::getMethodPaths() {
+	std::vector<BrowsePath> paths;
+	for(const char* method : {"GetRange", "CountByRange", "ReadByStartAndCount"}) {
+		paths.push_back({NodeId(0, UA_NS0ID_BASEOBJECTTYPE),
 				{{2,"RecordingType", UA_NS0ID_HASSUBTYPE},
 				 {2,"Data", UA_NS0ID_HASCOMPONENT},
-				 {2,"ReadByStartAndCount", UA_NS0ID_HASCOMPONENT}});
-	if(m_readByStartAndCountIdId.isNull()) {
-		std::cerr << "Node BaseObjectType/RecordingType/Data/ReadByStartAndCount not found!" << std::endl;
-		return UA_STATUSCODE_BADINTERNALERROR;
+				 {2,method, UA_NS0ID_HASCOMPONENT}}});
 	}
-	return UA_STATUSCODE_GOOD;
+	return paths;
 }
 
 uint32_t Recording::getId() const {
 	return m_id;
 }
 
+const NodeId& Recording::getDataId() const {
+	return m_dataId;
+}
+
 UA_StatusCode Recording::getRange(UA_DateTime& startTime, UA_DateTime& endTime) const {
 	UA_StatusCode retval = UA_STATUSCODE_GOOD;
 
@@ -85,6 +103,45 @@ UA_StatusCode Recording::getRange(UA_DateTime& startTime, UA_DateTime& endTime)
 	return retval;
 }
 
+std::future<OpcuaClient::CallResult> Recording::getRangeAsync() const {
+	return m_client.clientCallAsync(m_dataId, m_getRangeId, 0, nullptr);
+}
+
+UA_StatusCode Recording::getRange(const OpcuaClient::CallResult& result, UA_DateTime& startTime, UA_DateTime& endTime) const {
+	if(result.status != UA_STATUSCODE_GOOD) {
+		std::cerr << "Method call to GetRange of Recording"<<m_id<<" was unsuccessful: " << UA_StatusCode_name(result.status) << std::endl;
+		return result.status;
+	}
+	if(result.outputSize < 2) {
+		std::cerr << "Method call to GetRange of Recording"<<m_id<<" returned too few output arguments" << std::endl;
+		return UA_STATUSCODE_BADUNEXPECTEDERROR;
+	}
+	startTime = *(UA_DateTime*)result.output[0].data;
+	endTime = *(UA_DateTime*)result.output[1].data;
+	return UA_STATUSCODE_GOOD;
+}
+
+std::future<OpcuaClient::CallResult> Recording::countByRangeAsync(const UA_DateTime& startTime, const UA_DateTime& endTime) const {
+	UA_Variant input[2];
+	UA_Variant_init(&input[0]);
+	UA_Variant_init(&input[1]);
+	UA_Variant_setScalarCopy(&input[0], &startTime, &UA_TYPES[UA_TYPES_DATETIME]);
+	UA_Variant_setScalarCopy(&input[1], &endTime, &UA_TYPES[UA_TYPES_DATETIME]);
+	auto result = m_client.clientCallAsync(m_dataId, m_countByRangeId, 2, input);
+	for(auto& inp : input) {
+		UA_Variant_clear(&inp);
+	}
+	return result;
+}
+
+int Recording::countByRange(const OpcuaClient::CallResult& result) const {
+	if(result.status != UA_STATUSCODE_GOOD || result.outputSize < 1) {
+		std::cerr << "Method call to CountByRange of Recording"<<m_id<<" was unsuccessful: " << UA_StatusCode_name(result.status) << std::endl;
+		return -1;
+	}
+	return *(UA_UInt32*)result.output[0].data;
+}
+
 int Recording::countByRange(const UA_DateTime& startTime, const UA_DateTime& endTime) const {
 	int retval = 0;
 	UA_StatusCode status = UA_STATUSCODE_GOOD;
@@ -105,43 +162,172 @@ int Recording::countByRange(const UA_DateTime& startTime, const UA_DateTime& end
 	return retval;
 }
 
-UA_StatusCode Recording::readByStartAndCount(const UA_DateTime& startTime, const uint32_t& count) const {
+UA_StatusCode Recording::readByStartAndCount(const UA_DateTime& startTime, const uint32_t& count, uint64_t& points) const {
+	RecordedPoints data;
+	UA_StatusCode retval = fetchByStartAndCount(startTime, count, data);
+	const UA_StatusCode decoded = decodeData(data, points);
+	if(retval == UA_STATUSCODE_GOOD) {
+		retval = decoded;
+	}
+	return retval;
+}
+
+UA_StatusCode Recording::streamByStartAndCount(const UA_DateTime& startTime, const uint32_t& count, uint64_t& points) const {
+	bool skipped = false;
+	const UA_StatusCode retval = fetchByStartAndCount(startTime, count, [this, &points, &skipped](RecordedPoints& chunk, RecordedPoints&) {
+		return skipMalformed(decodeData(chunk, points), skipped);
+	});
+	return (retval == UA_STATUSCODE_GOOD && skipped) ? UA_STATUSCODE_BADDECODINGERROR : retval;
+}
+
+UA_StatusCode Recording::readNewerThan(const UA_DateTime& startTime, const UA_DateTime& endTime, int64_t& watermark, uint64_t& points) const {
+	const int count = countByRange(startTime, endTime);
+	if(count < 0) {
+		return UA_STATUSCODE_BADINTERNALERROR;
+	}
+	// Newest point received; points up to it are received again at the start of the next chunk
+	int64_t received = watermark;
+	bool skipped = false;
+	const UA_StatusCode retval = fetchByStartAndCount(startTime, count, [this, &received, &watermark, &points, &skipped](RecordedPoints& chunk, RecordedPoints& spare) -> UA_StatusCode {
+		for(auto it = chunk.begin(); it != chunk.end(); ) {
+			if(it->second.starttimeutc() <= received) {
+				spare.splice(spare.end(), chunk, it++);
+			} else {
+				received = it->second.starttimeutc();
+				++it;
+			}
+		}
+		/* The watermark only covers the points actually printed. A malformed point never
+		 * decodes; the watermark passes it with the next point printed.
+		 */
+		return skipMalformed(decodeData(chunk, points, watermark), skipped);
+	});
+	return (retval == UA_STATUSCODE_GOOD && skipped) ? UA_STATUSCODE_BADDECODINGERROR : retval;
+}
+
+UA_StatusCode Recording::readTail(const uint32_t& count, uint64_t& points) const {
+	if(count == 0) {
+		return UA_STATUSCODE_GOOD;
+	}
+	UA_DateTime rangeStart, rangeEnd;
+	UA_StatusCode retval = getRange(rangeStart, rangeEnd);
+	if(retval != UA_STATUSCODE_GOOD) {
+		return retval;
+	}
+
+	// The newest configuration determines the interval of the newest points
+	uint32_t intervalSeconds;
+	retval = getInterval(intervalSeconds);
+	if(retval != UA_STATUSCODE_GOOD) {
+		return retval;
+	}
+	const UA_DateTime interval = std::max<UA_DateTime>(1, intervalSeconds) * UA_DATETIME_SEC;
+
+	// Boundaries between full seconds, so it does not matter whether CountByRange() includes them
+	const UA_DateTime endTime = rangeEnd + UA_DATETIME_SEC / 2;
+	UA_DateTime startTime = std::max(rangeStart, rangeEnd - (count - 1) * interval) - UA_DATETIME_SEC / 2;
+	int available = countByRange(startTime, endTime);
+	if(available < 0) {
+		return UA_STATUSCODE_BADINTERNALERROR;
+	}
+	// Widen the window while points are missing (e.g. the device was switched off for some time)
+	for(unsigned i=0; available < (int)count && startTime > rangeStart; i++) {
+		const UA_DateTime missing = ((UA_DateTime)count - available) * interval << std::min(i, 8u);
+		startTime = std::max<UA_DateTime>(rangeStart - UA_DATETIME_SEC / 2, startTime - missing);
+		available = countByRange(startTime, endTime);
+		if(available < 0) {
+			return UA_STATUSCODE_BADINTERNALERROR;
+		}
+	}
+	// Narrow the window once if it holds too many points, so less data is transferred
+	if(available > (int)count) {
+		const UA_DateTime narrowed = startTime + ((UA_DateTime)available - count) * interval;
+		const int c = countByRange(narrowed, endTime);
+		if(c >= (int)count) {
+			startTime = narrowed;
+			available = c;
+		}
+	}
+
+	/* Read all points of the window and skip the oldest ones exceeding the requested count */
+	int skip = available - (int)count;
+	bool skipped = false;
+	retval = fetchByStartAndCount(startTime, available, [this, &skip, &points, &skipped](RecordedPoints& chunk, RecordedPoints& spare) {
+		while(skip > 0 && !chunk.empty()) {
+			spare.splice(spare.end(), chunk, chunk.begin());
+			skip--;
+		}
+		return skipMalformed(decodeData(chunk, points), skipped);
+	});
+	return (retval == UA_STATUSCODE_GOOD && skipped) ? UA_STATUSCODE_BADDECODINGERROR : retval;
+}
+
+UA_StatusCode Recording::getInterval(uint32_t& seconds) const {
+	seconds = 1;
+	if(m_configIds.empty()) {
+		return UA_STATUSCODE_GOOD;
+	}
+	// The newest configuration has the highest id
+	const auto newest = std::max_element(m_configIds.begin(), m_configIds.end(),
+			[](const auto& a, const auto& b) { return a.first < b.first; });
+	const RecordingConfiguration* cfg = getConfiguration(newest->first);
+	if(!cfg) {
+		return UA_STATUSCODE_BADNOTFOUND;
+	}
+	seconds = cfg->interval_seconds;
+	return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode Recording::fetchByStartAndCount(const UA_DateTime& startTime, const uint32_t& count, RecordedPoints& data) const {
+	return fetchByStartAndCount(startTime, count, [&data](RecordedPoints& chunk, RecordedPoints&) {
+		data.splice(data.end(), chunk);
+		return UA_STATUSCODE_GOOD;
+	});
+}
+
+UA_StatusCode Recording::fetchByStartAndCount(const UA_DateTime& startTime, const uint32_t& count, const ChunkHandler& handler) const {
 	UA_StatusCode retval = UA_STATUSCODE_GOOD;
 	int remain = count;
+	// Checkpoint of the transfer; only advanced after a chunk was delivered successfully
 	UA_DateTime nextStartTime = startTime;
-	std::list<std::pair<uint32_t, records::RecordedData>> data;
+	RecordedPoints chunk;
+	// Points handed over before and not consumed by the handler; their buffers are reused
+	RecordedPoints spare;
 	while(remain > 0) {
-		UA_Variant input[2] = {0};
 		size_t outputSize;
 		UA_Variant *output;
-		UA_Variant_setScalarCopy(&input[0], &nextStartTime, &UA_TYPES[UA_TYPES_DATETIME]);
-		UA_Variant_setScalarCopy(&input[1], &count, &UA_TYPES[UA_TYPES_UINT32]);
-		retval = m_client.clientCall(m_dataId, m_readByStartAndCountIdId, 2, input, &outputSize, &output);
-		for(auto& inp : input) {
-			UA_Variant_clear(&inp);
-		}
+		retval = callReadByStartAndCount(nextStartTime, count, &outputSize, &output);
 		if(retval != UA_STATUSCODE_GOOD) {
 			std::cerr << "Method call 'ReadByStartAndCount' was unsuccessful " << UA_StatusCode_name(retval) << std::endl;
 			break;
 		} else {
-			if(nextStartTime >= *(UA_DateTime*)output[1].data) {
+			const UA_DateTime lastDateTime = *(UA_DateTime*)output[1].data;
+			if(nextStartTime >= lastDateTime) {
 				std::cerr << "Warning: Read LastDateTime is not bigger than start-time from last read! Stopping here!";
 				remain = 0;
 			}
-			nextStartTime = *(UA_DateTime*)output[1].data;
 			const size_t recordingPoints = output[2].arrayDimensions[0];
 			UA_ExtensionObject* e = (UA_ExtensionObject*)output[2].data;
 			for(size_t i=0; i<recordingPoints; i++) {
-				UA_RecordingPoint* p = (UA_RecordingPoint*)e[i].content.decoded.data;
-				UA_ByteString* b = &(p->data);
+				RecordingPointView p;
+				if(!getRecordingPoint(e[i], p)) {
+					std::cerr << "Failed to decode Recording-Point " << i << "(Recording" << m_id << ")" << std::endl;
+					continue;
+				}
 				/* The received Data is stored in a google protobuf structure.
-				 * Parse the received Byte-String as protobuf here!
+				 * Decode the received Byte-String into the columns of the point here!
 				 */
-				records::RecordedData protobuf;
-				if(!protobuf.ParseFromArray(b->data, b->length)) {
-					std::cerr << "Failed to decode protobuffer of Recording-Point " << i << "(Recording" << m_id << ")" << std::endl;
+				if(spare.empty()) {
+					chunk.emplace_back();
 				} else {
-					data.emplace_back(p->configId, protobuf);
+					chunk.splice(chunk.end(), spare, spare.begin());
+				}
+				chunk.back().first = p.configId;
+				if(!RecordedDataDecoder::decode(p.data, p.length, chunk.back().second)) {
+					std::cerr << "Failed to decode protobuffer of Recording-Point " << i << "(Recording" << m_id << ")" << std::endl;
+					spare.splice(spare.end(), chunk, std::prev(chunk.end()));
+				} else if(m_client.getVerifyDecoder() && !RecordedDataDecoder::verify(p.data, p.length, chunk.back().second)) {
+					std::cerr << "Decoded Recording-Point " << i << "(Recording" << m_id << ") differs from protobuf library" << std::endl;
 				}
 			}
 			UA_Array_delete(output, outputSize, &UA_TYPES[UA_TYPES_VARIANT]);
@@ -149,124 +335,451 @@ UA_StatusCode Recording::readByStartAndCount(const UA_DateTime& startTime, const
 				std::cerr << "Warning: no recording points returned while expecting " << remain << " more points! Stopping here!" << std::endl;
 				remain = 0;
 			}
+			// Hand over the chunk, so it can be processed before the next one is requested
+			retval = handler(chunk, spare);
+			spare.splice(spare.end(), chunk);
+			if(retval != UA_STATUSCODE_GOOD) {
+				break;
+			}
 			remain -= recordingPoints;
+			nextStartTime = lastDateTime;
 		}
 	}
 
-	retval = decodeData(data);
+	return retval;
+}
+
+bool Recording::getRecordingPoint(const UA_ExtensionObject& e, RecordingPointView& point) {
+	if(e.encoding >= UA_EXTENSIONOBJECT_DECODED) {
+		if(e.content.decoded.type != &UA_RecordingPointType && !UA_NodeId_equal(&e.content.decoded.type->typeId, &UA_RecordingPointType.typeId)) {
+			return false;
+		}
+		const UA_RecordingPoint* p = (const UA_RecordingPoint*)e.content.decoded.data;
+		point.configId = p->configId;
+		point.data = p->data.data;
+		point.length = p->data.length;
+		return true;
+	}
+	// Left encoded, if UA_RecordingPointType is not registered (see OpcuaClient::setRawRecordingPoints())
+	if(e.encoding == UA_EXTENSIONOBJECT_ENCODED_BYTESTRING
+			&& UA_NodeId_equal(&e.content.encoded.typeId, &UA_RecordingPointType.binaryEncodingId)) {
+		return RecordedDataDecoder::decodeRecordingPoint(e.content.encoded.body.data, e.content.encoded.body.length, point);
+	}
+	return false;
+}
+
+UA_StatusCode Recording::callReadByStartAndCount(const UA_DateTime& startTime, const uint32_t& count, size_t *outputSize, UA_Variant **output) const {
+	UA_StatusCode retval = UA_STATUSCODE_GOOD;
+	const OpcuaClient::RetryPolicy& policy = m_client.getRetryPolicy();
+	std::chrono::milliseconds backoff = policy.initialBackoff;
+
+	for(unsigned attempt = 0; ; attempt++) {
+		UA_Variant input[2];
+		UA_Variant_init(&input[0]);
+		UA_Variant_init(&input[1]);
+		UA_Variant_setScalarCopy(&input[0], &startTime, &UA_TYPES[UA_TYPES_DATETIME]);
+		UA_Variant_setScalarCopy(&input[1], &count, &UA_TYPES[UA_TYPES_UINT32]);
+		{
+			// Wait until the device may take another request; the latency is fed back to the controller
+			ConcurrencyController::Slot slot(m_client.concurrency());
+			retval = m_client.clientCall(m_dataId, m_readByStartAndCountIdId, 2, input, outputSize, output);
+			slot.done(retval);
+		}
+		for(auto& inp : input) {
+			UA_Variant_clear(&inp);
+		}
+		if(retval == UA_STATUSCODE_GOOD || attempt >= policy.maxRetries) {
+			break;
+		}
+
+		/* The session may be broken (e.g. by a flaky link), so reconnect and continue at the
+		 * checkpoint instead of starting the whole transfer again.
+		 */
+		std::cerr << "Method call 'ReadByStartAndCount' of Recording" << m_id << " failed with " << UA_StatusCode_name(retval)
+				<< "; resuming at " << OpcUaUtil::dateTimeToString(startTime) << " in " << backoff.count() << "ms (retry "
+				<< attempt+1 << "/" << policy.maxRetries << ")" << std::endl;
+		std::this_thread::sleep_for(backoff);
+		backoff = std::min(backoff * 2, policy.maxBackoff);
+		if(!m_client.reconnect()) {
+			std::cerr << "Reconnect to " << m_client.getUrl() << " failed" << std::endl;
+		}
+	}
 
 	return retval;
 }
 
+UA_StatusCode Recording::readByRangeSharded(const UA_DateTime& startTime, const UA_DateTime& stopTime, const unsigned& shards, uint64_t& points) const {
+	const int count = countByRange(startTime, stopTime);
+	if(count < 0) {
+		return UA_STATUSCODE_BADINTERNALERROR;
+	}
+	if(shards <= 1 || count < (int)shards) {
+		return readByStartAndCount(startTime, count, points);
+	}
+	const std::vector<UA_DateTime> bounds = splitRange(startTime, stopTime, count, shards);
+	const size_t shardCount = bounds.size() - 1;
+	std::vector<RecordedPoints> parts(shardCount);
+	std::vector<UA_StatusCode> results(shardCount, UA_STATUSCODE_GOOD);
+	std::vector<std::thread> workers;
 
-template<typename T>
-void Recording::printProtobuf(RecordingConfiguration& cfg, const T& protobuf, size_t& index, const std::string& browsename) const {
-	std::cout << "\"" << browsename << "\" : { ";
-	if(cfg.algorithm == UA_RECORDINGALGORITHM_AVERAGE) {
-		std::cout << "\"avg\" : " << protobuf.avgvalue(index) << " ";
-	} else {
-		std::cout << "\"sample\" : " << protobuf.sample(index) << " ";
+	/* Each shard gets its own session, since a single UA_Client must not be used by multiple threads.
+	 * The NodeIds are taken over from this Recording, so the shard sessions don't need to browse.
+	 */
+	for(size_t i=0; i<shardCount; i++) {
+		workers.emplace_back([this, i, &bounds, &parts, &results]() {
+			Umg801 session;
+			session.shareConcurrency(m_client);
+			session.setRawRecordingPoints(m_client.getRawRecordingPoints());
+			session.setVerifyDecoder(m_client.getVerifyDecoder());
+			if(!session.connect(m_client.getUrl())) {
+				results[i] = UA_STATUSCODE_BADCONNECTIONCLOSED;
+				return;
+			}
+			const Recording shard(session, *this);
+			const int points = shard.countByRange(bounds[i], bounds[i+1]);
+			if(points < 0) {
+				results[i] = UA_STATUSCODE_BADINTERNALERROR;
+			} else if(points > 0) {
+				results[i] = shard.fetchByStartAndCount(bounds[i], points, parts[i]);
+			}
+		});
 	}
-	if(cfg.extremals.minimum) {
-		std::cout << ", \"min\" : " << protobuf.minvalue(index) << " ";
-		if(cfg.extremals.timestamps) {
-			std::cout << ", \"min_time\" : " << protobuf.mintimestamp(index) << " ";
+	for(auto& w : workers) {
+		w.join();
+	}
+
+	/* Stitch shards in timestamp order. A shard may deliver points beyond its upper boundary
+	 * (which belong to the next shard), so drop everything that is not newer than the last kept point.
+	 */
+	UA_StatusCode retval = UA_STATUSCODE_GOOD;
+	RecordedPoints data;
+	for(size_t i=0; i<shardCount; i++) {
+		if(results[i] != UA_STATUSCODE_GOOD) {
+			std::cerr << "Failed to read shard " << i << " of Recording" << m_id << ": " << UA_StatusCode_name(results[i]) << std::endl;
+			retval = results[i];
 		}
+		for(auto it = parts[i].begin(); it != parts[i].end(); ) {
+			const UA_DateTime t = OpcUaUtil::unixTimeToDateTime(it->second.starttimeutc());
+			const bool beyondShard = (i+1 < shardCount) && (t >= bounds[i+1]);
+			const bool duplicate = !data.empty() && (it->second.starttimeutc() <= data.back().second.starttimeutc());
+			if(beyondShard || duplicate) {
+				it = parts[i].erase(it);
+			} else {
+				++it;
+			}
+		}
+		data.splice(data.end(), parts[i]);
 	}
-	if(cfg.extremals.maximum) {
-		std::cout << ", \"max\" : " << protobuf.maxvalue(index) << " ";
-		if(cfg.extremals.timestamps) {
-			std::cout << ", \"max_time\" : " << protobuf.maxtimestamp(index) << " ";
+
+	const UA_StatusCode decoded = decodeData(data, points);
+	if(retval == UA_STATUSCODE_GOOD) {
+		retval = decoded;
+	}
+	return retval;
+}
+
+std::vector<UA_DateTime> Recording::splitRange(const UA_DateTime& startTime, const UA_DateTime& stopTime, const int& count, const unsigned& shards) const {
+	std::vector<UA_DateTime> bounds = {startTime};
+	const int tolerance = count / (shards * 20);
+
+	for(unsigned i=1; i<shards; i++) {
+		const int target = (int)(((int64_t)count * i) / shards);
+		UA_DateTime lower = bounds.back();
+		UA_DateTime upper = stopTime;
+		// Bisect until the boundary is exact to a second or the number of points is good enough
+		while(upper - lower > UA_DATETIME_SEC) {
+			const UA_DateTime mid = lower + (upper - lower) / 2;
+			const int c = countByRange(startTime, mid);
+			if(c < 0) {
+				std::cerr << "Failed to split Recording" << m_id << " into shards; using a single shard" << std::endl;
+				return {startTime, stopTime};
+			}
+			if(c < target - tolerance) {
+				lower = mid;
+			} else if(c > target + tolerance) {
+				upper = mid;
+			} else {
+				upper = mid;
+				break;
+			}
+		}
+		// Move the boundary between two full seconds, so it does not collide with a recording point
+		const UA_DateTime boundary = OpcUaUtil::unixTimeToDateTime(OpcUaUtil::dateTimeToUnixTime(upper)) + UA_DATETIME_SEC / 2;
+		if(boundary > bounds.back() && boundary < stopTime) {
+			bounds.push_back(boundary);
 		}
 	}
-	std::cout << " }, " << std::endl;
+	bounds.push_back(stopTime);
+
+	return bounds;
+}
 
-	/* Here we increment the index of the specific type-array in the protobuffer,
-	 * so the next call will fetch the next element.
+
+
+UA_StatusCode Recording::findGaps(const std::vector<int64_t>& localTimes, const UA_DateTime& startTime, const UA_DateTime& endTime,
+		const uint32_t& bucketSeconds, std::vector<RecordingGap>& gaps) const {
+	/* Place all boundaries between two full seconds. Recording points are stored with a resolution of
+	 * seconds, so no point lies on a boundary and it does not matter whether CountByRange() includes them.
 	 */
-	index++;
+	const UA_DateTime half = UA_DATETIME_SEC / 2;
+	const UA_DateTime first = OpcUaUtil::unixTimeToDateTime(OpcUaUtil::dateTimeToUnixTime(startTime)) - half;
+	const UA_DateTime last = OpcUaUtil::unixTimeToDateTime(OpcUaUtil::dateTimeToUnixTime(endTime)) + half;
+	const UA_DateTime width = std::max<UA_DateTime>(1, bucketSeconds) * UA_DATETIME_SEC;
+
+	std::vector<RecordingGap> buckets;
+	for(UA_DateTime t = first; t < last; t += width) {
+		buckets.push_back({t, std::min(t + width, last), 0});
+	}
+
+	// Request the counts of all buckets at once
+	std::vector<std::future<OpcuaClient::CallResult>> pending;
+	for(const auto& b : buckets) {
+		pending.emplace_back(countByRangeAsync(b.startTime, b.endTime));
+	}
+	for(size_t i=0; i<buckets.size(); i++) {
+		buckets[i].count = countByRange(m_client.await(pending[i]));
+		if(buckets[i].count < 0) {
+			return UA_STATUSCODE_BADINTERNALERROR;
+		}
+	}
+
+	for(const auto& b : buckets) {
+		const UA_StatusCode retval = bisectGap(localTimes, b, gaps);
+		if(retval != UA_STATUSCODE_GOOD) {
+			return retval;
+		}
+	}
+	return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode Recording::bisectGap(const std::vector<int64_t>& localTimes, const RecordingGap& interval, std::vector<RecordingGap>& gaps) const {
+	const int local = countLocal(localTimes, interval.startTime, interval.endTime);
+	if(interval.count <= local) {
+		return UA_STATUSCODE_GOOD; // complete (or the device dropped old data)
+	}
+	if(local == 0 || interval.endTime - interval.startTime <= UA_DATETIME_SEC) {
+		// Merge with the previous gap if they are adjacent
+		if(!gaps.empty() && gaps.back().endTime == interval.startTime) {
+			gaps.back().endTime = interval.endTime;
+			gaps.back().count += interval.count;
+		} else {
+			gaps.push_back(interval);
+		}
+		return UA_STATUSCODE_GOOD;
+	}
+
+	const UA_DateTime mid = OpcUaUtil::unixTimeToDateTime(
+			OpcUaUtil::dateTimeToUnixTime(interval.startTime + (interval.endTime - interval.startTime) / 2)) + UA_DATETIME_SEC / 2;
+	const int lower = countByRange(interval.startTime, mid);
+	if(lower < 0) {
+		return UA_STATUSCODE_BADINTERNALERROR;
+	}
+	// The upper half needs no extra call, its count is the difference
+	UA_StatusCode retval = bisectGap(localTimes, {interval.startTime, mid, lower}, gaps);
+	if(retval == UA_STATUSCODE_GOOD) {
+		retval = bisectGap(localTimes, {mid, interval.endTime, interval.count - lower}, gaps);
+	}
+	return retval;
+}
+
+int Recording::countLocal(const std::vector<int64_t>& localTimes, const UA_DateTime& startTime, const UA_DateTime& endTime) {
+	const int64_t first = OpcUaUtil::dateTimeToUnixTime(startTime + UA_DATETIME_SEC - 1);
+	const int64_t last = OpcUaUtil::dateTimeToUnixTime(endTime);
+	return std::upper_bound(localTimes.begin(), localTimes.end(), last) - std::lower_bound(localTimes.begin(), localTimes.end(), first);
+}
+
+UA_StatusCode Recording::backfill(const std::vector<int64_t>& localTimes, const std::vector<RecordingGap>& gaps, uint64_t& points) const {
+	bool skipped = false;
+	for(const auto& gap : gaps) {
+		const int64_t last = OpcUaUtil::dateTimeToUnixTime(gap.endTime);
+		const UA_StatusCode retval = fetchByStartAndCount(gap.startTime, gap.count, [&](RecordedPoints& chunk, RecordedPoints& spare) {
+			// Drop points held locally already and points beyond the gap
+			for(auto it = chunk.begin(); it != chunk.end(); ) {
+				const int64_t t = it->second.starttimeutc();
+				if(t > last || std::binary_search(localTimes.begin(), localTimes.end(), t)) {
+					spare.splice(spare.end(), chunk, it++);
+				} else {
+					++it;
+				}
+			}
+			return skipMalformed(decodeData(chunk, points), skipped);
+		});
+		if(retval != UA_STATUSCODE_GOOD) {
+			return retval;
+		}
+	}
+	return skipped ? UA_STATUSCODE_BADDECODINGERROR : UA_STATUSCODE_GOOD;
 }
 
-UA_StatusCode Recording::decodeData(std::list<std::pair<uint32_t, records::RecordedData>>& data) const {
+UA_StatusCode Recording::skipMalformed(const UA_StatusCode& decoded, bool& skipped) {
+	if(decoded == UA_STATUSCODE_BADDECODINGERROR) {
+		skipped = true;
+		return UA_STATUSCODE_GOOD;
+	}
+	return decoded;
+}
+
+const Recording::RecordingConfiguration* Recording::getConfiguration(const uint32_t& id) const {
+	// Get RecordingConfiguration from cache. Read from device if not known yet.
+	auto it = m_configs.find(id);
+	if(it == m_configs.end()) {
+		RecordingConfiguration cfg;
+		if(readRecordingConfiguration(id, cfg) != UA_STATUSCODE_GOOD) {
+			return nullptr;
+		}
+		it = m_configs.emplace(id, cfg).first;
+	}
+	return &it->second;
+}
+
+UA_StatusCode Recording::decodeData(const RecordedPoints& data, uint64_t& points) const {
+	int64_t newest = INT64_MIN;
+	return decodeData(data, points, newest);
+}
+
+UA_StatusCode Recording::decodeData(const RecordedPoints& data, uint64_t& points, int64_t& newest) const {
 	UA_StatusCode retval = UA_STATUSCODE_GOOD;
-	std::map<uint32_t, RecordingConfiguration> configs;
+	std::ostream& out = m_client.output();
 
 	for(const auto& d : data) {
-		// Get RecordingConfiguration from configs. Read from device if not known yet.
-		auto it = configs.find(d.first);
-		if(it == configs.end()) {
-			RecordingConfiguration cfg;
-			retval = readRecordingConfiguration(d.first, cfg);
-			if(retval != UA_STATUSCODE_GOOD) {
-				return retval;
+		const RecordingConfiguration* cfg = getConfiguration(d.first);
+		if(!cfg) {
+			return UA_STATUSCODE_BADNOTFOUND;
+		}
+
+		// Print the names of channels used for the first time
+		if(m_client.getDictionaryOutput() && !cfg->channelsEmitted) {
+			for(const auto& var : cfg->values) {
+				if(var.info.status == UA_REFERENCESTATUS_AVAILABLE) {
+					m_client.channels().emit(out, var.channel);
+				}
 			}
-			it = configs.emplace(d.first, cfg).first;
+			cfg->channelsEmitted = true;
+		}
+
+		if(!cfg->plan) {
+			cfg->plan = std::make_shared<DecodePlan>(*cfg, m_client.getDictionaryOutput());
+		}
+		if(!cfg->plan->validate(d.second)) {
+			std::cerr << "Skipping Recording-Point of Recording" << m_id << " with RecordingConfiguration " << d.first << std::endl;
+			retval = UA_STATUSCODE_BADDECODINGERROR;
+			continue;
 		}
-		RecordingConfiguration& cfg = it->second;
 
 		// Convert and print timestamp. Protobuffer holds time in Seconds UTC (POSIX time)
 		std::time_t time = d.second.starttimeutc();
-		std::cout << "{ \"time\" : \"" << std::put_time(std::localtime(&time), "%Y-%m-%d %X") << "\"" << std::endl;
-
-		size_t counts[8] = {0};
+		std::tm local;
+		out << "{ \"time\" : \"" << std::put_time(localtime_r(&time, &local), "%Y-%m-%d %X") << "\"" << std::endl;
 
 		/* The protobuffer holds arrays for each possible datatype that can be stored.
 		 * Depending of the configuration, the values are stored to the type-belonging arrays
-		 * in the same order as in configuration. To match values, we iterate throught the values in
-		 * configuration and fetch the next value from the array of the protobuffer.
+		 * in the same order as in configuration. The plan knows the position of each value in the arrays.
 		 */
-		for(const auto& var : cfg.values) {
-			if(var.info.status != UA_REFERENCESTATUS_AVAILABLE) {
-				// ignore values that are not available.
-				counts[var.info.typeInfo.dataType]++;
-				continue;
-			}
-			std::string name = var.browsePath;
-			if(var.info.typeInfo.array) {
-				name += "[" + std::to_string(var.info.value.arrayIndex) + "]";
-			}
+		cfg->plan->print(out, d.second);
 
-			switch(var.info.typeInfo.dataType) {
-			case UA_RecordingDataType::UA_RECORDINGDATATYPE_BOOLEAN:
-				printProtobuf(cfg, d.second.bool_(), counts[var.info.typeInfo.dataType], name); break;
-			case UA_RecordingDataType::UA_RECORDINGDATATYPE_INT32:
-				printProtobuf(cfg, d.second.sint32(), counts[var.info.typeInfo.dataType], name); break;
-			case UA_RecordingDataType::UA_RECORDINGDATATYPE_UINT32:
-				printProtobuf(cfg, d.second.uint32(), counts[var.info.typeInfo.dataType], name); break;
-			case UA_RecordingDataType::UA_RECORDINGDATATYPE_INT64:
-				printProtobuf(cfg, d.second.sint64(), counts[var.info.typeInfo.dataType], name); break;
-			case UA_RecordingDataType::UA_RECORDINGDATATYPE_UINT64:
-				printProtobuf(cfg, d.second.uint64(), counts[var.info.typeInfo.dataType], name); break;
-			case UA_RecordingDataType::UA_RECORDINGDATATYPE_FLOAT:
-				printProtobuf(cfg, d.second.float_(), counts[var.info.typeInfo.dataType], name); break;
-			case UA_RecordingDataType::UA_RECORDINGDATATYPE_DOUBLE:
-				printProtobuf(cfg, d.second.double_(), counts[var.info.typeInfo.dataType], name); break;
-			case UA_RecordingDataType::UA_RECORDINGDATATYPE_UNDEFINED:
-			default:
-				std::cerr << "Found UNDEFINED datatype; this should _not_ happen!";
+		out << "}," << std::endl;
+		points++;
+		newest = std::max<int64_t>(newest, d.second.starttimeutc());
+	}
+
+	return retval;
+}
+
+UA_StatusCode Recording::readConfigurations(std::list<Recording>& recordings) {
+	if(recordings.empty()) {
+		return UA_STATUSCODE_GOOD;
+	}
+	// Collect the attributes of all configurations not cached yet
+	std::vector<OpcuaClient::AttributeRef> attributes;
+	std::vector<std::pair<Recording*, uint32_t>> pending;
+	for(auto& r : recordings) {
+		for(const auto& c : r.m_configIds) {
+			if(r.m_configs.find(c.first) == r.m_configs.end()) {
+				for(const auto& a : getConfigurationAttributes(r.m_client.getHierarichalNodes(c.second))) {
+					attributes.push_back(a);
+				}
+				pending.emplace_back(&r, c.first);
 			}
 		}
+	}
+	if(pending.empty()) {
+		return UA_STATUSCODE_GOOD;
+	}
+	/* The browse paths of the values are resolved by the lookup table, which is requested
+	 * before the Read. So both requests are on the wire at the same time.
+	 */
+	Umg801& client = recordings.front().m_client;
+	client.prefetchLookupTable(UA_TAG_RECORDABLE);
+	const OpcuaClient::ReadResult result = client.readAttributes(attributes);
+	if(result.status != UA_STATUSCODE_GOOD) {
+		return result.status;
+	}
+	for(size_t i=0; i<pending.size(); i++) {
+		RecordingConfiguration cfg;
+		pending[i].first->parseConfiguration(pending[i].second, result, i*ConfigurationAttributes, cfg);
+		pending[i].first->m_configs.emplace(pending[i].second, cfg);
+	}
+	return UA_STATUSCODE_GOOD;
+}
 
-		std::cout << "}," << std::endl;
+const Recording::RecordingConfigurations& Recording::getConfigurations() const {
+	return m_configs;
+}
 
+void Recording::addConfigurations(const RecordingConfigurations& configs) {
+	for(const auto& c : configs) {
+		RecordingConfiguration cfg = c.second;
+		assignChannels(cfg);
+		m_configs.emplace(c.first, cfg);
 	}
+}
 
-	return retval;
+void Recording::assignChannels(RecordingConfiguration& cfg) const {
+	for(auto& v : cfg.values) {
+		v.channel = m_client.channels().getChannel(v.name);
+	}
+	cfg.channelsEmitted = false;
+}
+
+std::vector<OpcuaClient::AttributeRef> Recording::getConfigurationAttributes(const std::map<std::string, NodeId>& nodes) {
+	std::vector<OpcuaClient::AttributeRef> attributes;
+	// Order must match parseConfiguration()
+	for(const char* name : {"Algorithm", "Extremals", "Interval", "Values"}) {
+		auto n = nodes.find(name);
+		attributes.push_back({n != nodes.end() ? n->second : NodeId()});
+	}
+	return attributes;
 }
 
 UA_StatusCode Recording::readRecordingConfiguration(const uint32_t& id, RecordingConfiguration& cfg) const {
-	UA_StatusCode retval = UA_STATUSCODE_GOOD;
-	const auto cfgIter = m_configIds.find(id);
+	auto cfgIter = m_configIds.find(id);
+	if(cfgIter == m_configIds.end()) {
+		// The configuration may have been created after discovery (or the metadata snapshot), so browse again
+		for(const auto& c : m_client.getHierarichalNodes(std::vector<NodeId>{m_nodeId}).front()) {
+			if(OpcUaUtil::isPrefix(c.first,"RecordingConfiguration")) {
+				m_configIds.emplace(OpcUaUtil::getIdSuffix(c.first),c.second);
+			}
+		}
+		cfgIter = m_configIds.find(id);
+	}
 	if(cfgIter == m_configIds.end()) {
 		std::cerr << "Failed to get " << "RecordingConfiguration"+std::to_string(id) << " from node " << m_nodeId.toString() <<": NodeId not found!"<< std::endl;
 		return UA_STATUSCODE_BADNOTFOUND;
 	}
-	auto nodes = m_client.getHierarichalNodes(cfgIter->second);
+	const OpcuaClient::ReadResult result = m_client.readAttributes(getConfigurationAttributes(m_client.getHierarichalNodes(cfgIter->second)));
+	if(result.status != UA_STATUSCODE_GOOD) {
+		return result.status;
+	}
+	parseConfiguration(id, result, 0, cfg);
+	return UA_STATUSCODE_GOOD;
+}
+
+void Recording::parseConfiguration(const uint32_t& id, const OpcuaClient::ReadResult& result, const size_t& offset, RecordingConfiguration& cfg) const {
 	cfg.id = id;
-	cfg.algorithm = m_client.getVariantValue<UA_RecordingAlgorithm>(nodes["Algorithm"]);
-	cfg.extremals = m_client.getVariantValue<UA_RecordingExtremals>(nodes["Extremals"]);
-	cfg.interval_seconds = m_client.getVariantValue<UA_UInt32>(nodes["Interval"]);
-	for(const auto& v : m_client.getVariantArrayValue<UA_RecordingValueInfo>(nodes["Values"])) {
+	cfg.algorithm = result.getValue<UA_RecordingAlgorithm>(offset);
+	cfg.extremals = result.getValue<UA_RecordingExtremals>(offset+1);
+	cfg.interval_seconds = result.getValue<UA_UInt32>(offset+2);
+	for(const auto& v : result.getArrayValue<UA_RecordingValueInfo>(offset+3)) {
 		std::string browsepath = "";
 		if(v.status == UA_REFERENCESTATUS_AVAILABLE) {
 			auto p = m_client.lookup(NodeId(v.value.node), UA_TAG_RECORDABLE);
@@ -276,17 +789,17 @@ UA_StatusCode Recording::readRecordingConfiguration(const uint32_t& id, Recordin
 		}
 		cfg.values.emplace_back(RecordingValueInfo(v, browsepath));
 	}
+	assignChannels(cfg);
 
 	// Print configuration information
-	std::cout << "RecordingConfig" << cfg.id << ": Algorithm=";
-	if(cfg.algorithm == UA_RECORDINGALGORITHM_SAMPLE) std::cout << "Sample; Extremals:";
-	else std::cout << "Average; Extremals:";
-	if(cfg.extremals.maximum) std::cout << "max,";
-	if(cfg.extremals.minimum) std::cout << "min,";
-	if(cfg.extremals.timestamps) std::cout << "timestmaps";
-	std::cout << "; Interval=" << cfg.interval_seconds << "sec ";
-	std::cout << "; Value-Count=" << cfg.values.size() << std::endl;
-
-	return retval;
+	std::ostream& out = m_client.output();
+	out << "RecordingConfig" << cfg.id << ": Algorithm=";
+	if(cfg.algorithm == UA_RECORDINGALGORITHM_SAMPLE) out << "Sample; Extremals:";
+	else out << "Average; Extremals:";
+	if(cfg.extremals.maximum) out << "max,";
+	if(cfg.extremals.minimum) out << "min,";
+	if(cfg.extremals.timestamps) out << "timestmaps";
+	out << "; Interval=" << cfg.interval_seconds << "sec ";
+	out << "; Value-Count=" << cfg.values.size() << std::endl;
 }
 
@@ -9,25 +9,127 @@
 #define RECORDING_HPP_
 
 #include "OpcuaClient.hpp"
-#include "records.pb.h"
+#include "RecordedDataDecoder.hpp"
 #include <list>
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <functional>
+#include <memory>
 
 class Umg801;
+class DecodePlan;
+
+/**
+ * Time range and number of recording points available on the device for a Recording
+ */
+struct RecordingRange {
+	UA_StatusCode status;
+	UA_DateTime startTime;
+	UA_DateTime endTime;
+	int count;
+};
+
+/**
+ * Time interval in which the device holds more recording points than a local copy
+ */
+struct RecordingGap {
+	UA_DateTime startTime;
+	UA_DateTime endTime;
+	int count;
+};
 
 class Recording {
 public:
+	/**
+	 * Object to hold information about a single value from RecordingConfiguration
+	 * including belonging browsePath
+	 */
+	class RecordingValueInfo {
+	public:
+		RecordingValueInfo(const UA_RecordingValueInfo &i, const std::string &s) :
+				info(i), browsePath(s), name(s), channel(0) {
+			if(info.typeInfo.array) {
+				name += "[" + std::to_string(info.value.arrayIndex) + "]";
+			}
+		}
+		UA_RecordingValueInfo info;
+		std::string browsePath;
+		/** Browse path including the array index */
+		std::string name;
+		/** Id of the value in the ChannelDictionary of the device */
+		uint32_t channel;
+	};
+
+	/**
+	 * Object to hold all information for mapping of values in Protobuffers
+	 */
+	class RecordingConfiguration {
+	public:
+		RecordingConfiguration() :
+			id(0), algorithm(), extremals(), interval_seconds(), values() {}
+		uint32_t id;
+		UA_RecordingAlgorithm algorithm;
+		UA_RecordingExtremals extremals;
+		uint32_t interval_seconds;
+		std::vector<RecordingValueInfo> values;
+		/** All channels of the values were printed to the dictionary of the output */
+		mutable bool channelsEmitted = false;
+		/** Compiled on first use by decodeData() */
+		mutable std::shared_ptr<DecodePlan> plan;
+	};
+
+	using RecordingConfigurations = std::unordered_map<uint32_t, RecordingConfiguration>;
+
+	/**
+	 * List of Tuples with RecordingConfiguration-Id and the decoded Protobuffers holding the recorded measurement values
+	 */
+	using RecordedPoints = std::list<std::pair<uint32_t, RecordedColumns>>;
+
+	/**
+	 * Callback that is invoked for every chunk of recording points received from the device.
+	 * The handler may consume (move/splice) the points of the chunk. Points it drops should be
+	 * spliced into spare instead of being erased, so their buffers are reused for the next chunk.
+	 * Returning anything else than UA_STATUSCODE_GOOD stops reading.
+	 */
+	using ChunkHandler = std::function<UA_StatusCode(RecordedPoints& chunk, RecordedPoints& spare)>;
+
 	Recording(Umg801& client, const uint32_t& id, const NodeId& nodeId);
 
 	/**
 	 * Fetch all relevant NodeIDs for reading Recording data. This should be done before any
 	 * other operation!
-	 * @note: This could be done more efficient by caching and summarized opcua-requests
 	 * @return OPC-UA Statuscode
 	 */
 	UA_StatusCode getNodeIds();
 
+	/**
+	 * Browse paths of the methods GetRange, CountByRange and ReadByStartAndCount (in this order),
+	 * which are shared by all recordings.
+	 */
+	static std::vector<BrowsePath> getMethodPaths();
+
+	/**
+	 * Read all RecordingConfigurations of the given recordings, that are not cached yet, with a
+	 * single Read request. The lookup table for the browse paths of their values is requested
+	 * concurrently. getNodeIds() must have been called for all recordings.
+	 * @param recordings Recordings of the same device
+	 * @return OPC-UA Statuscode
+	 */
+	static UA_StatusCode readConfigurations(std::list<Recording>& recordings);
+
+	/**
+	 * @return All RecordingConfigurations of this recording read so far
+	 */
+	const RecordingConfigurations& getConfigurations() const;
+
+	/**
+	 * Add already known RecordingConfigurations (e.g. from a metadata snapshot) to the cache,
+	 * so they are not read from the device.
+	 * @param configs Configurations to be added
+	 */
+	void addConfigurations(const RecordingConfigurations& configs);
+
 	/**
 	 * Run a OPC-UA-RPC-Call to /Objects/Device/Recordings/Recording<id>/data/GetRange()
 	 * to determine time-range of available Data
@@ -37,6 +139,22 @@ public:
 	 */
 	UA_StatusCode getRange(UA_DateTime& startTime, UA_DateTime& endTime) const;
 
+	/**
+	 * Send the OPC-UA-RPC-Call to GetRange() without waiting for the response.
+	 * The response has to be collected with OpcuaClient::await() and evaluated by getRange(result, ...).
+	 * @return Future of the call result
+	 */
+	std::future<OpcuaClient::CallResult> getRangeAsync() const;
+
+	/**
+	 * Evaluate the result of an asynchronous GetRange() call
+	 * @param result Result of the call started by getRangeAsync()
+	 * @startTime Output-Parameter which is filled with timestamp of the oldest available data point
+	 * @endTime Output-Parameter which is filled with timestamp of the newest available data point
+	 * @return OPC-UA Statuscode
+	 */
+	UA_StatusCode getRange(const OpcuaClient::CallResult& result, UA_DateTime& startTime, UA_DateTime& endTime) const;
+
 	/**
 	 * Get Number of Recording Points on device in a certain Time Range.
 	 * @param startTime
@@ -45,70 +163,275 @@ public:
 	 */
 	int countByRange(const UA_DateTime& startTime, const UA_DateTime& endTime) const;
 
+	/**
+	 * Send the OPC-UA-RPC-Call to CountByRange() without waiting for the response.
+	 * @param startTime
+	 * @param endTime
+	 * @return Future of the call result
+	 */
+	std::future<OpcuaClient::CallResult> countByRangeAsync(const UA_DateTime& startTime, const UA_DateTime& endTime) const;
+
+	/**
+	 * Evaluate the result of an asynchronous CountByRange() call
+	 * @param result Result of the call started by countByRangeAsync()
+	 * @return Number of recordings, -1 on error
+	 */
+	int countByRange(const OpcuaClient::CallResult& result) const;
+
 	/**
 	 * Read Recoding Data beginning on a certain Start-Time limited by a number of recording points.
 	 * This method will internally subsequently do OPC-UA-RPC-Calls to
 	 *  /Objects/Device/Recordings/Recording<id>/data/ReadByStartAndCount()
 	 * until all requested data is read. It must be called multiple times, because the device will always
 	 * return a maximum payload of 1MB!
+	 * If a call fails, the session is reconnected and the transfer is resumed after the last received chunk.
 	 * @note For this example the resulting Data is just printed to STDOUT
 	 * @param startTime Timestamp for start reading
 	 * @param count Number of recording points to be read beginning on startTime
+	 * @param points Output parameter that is increased by the number of points printed
+	 * @return OPC-UA Statuscode
+	 */
+	UA_StatusCode readByStartAndCount(const UA_DateTime& startTime, const uint32_t& count, uint64_t& points) const;
+
+	/**
+	 * Same as readByStartAndCount(), but every chunk received from the device is decoded and printed
+	 * as soon as it arrives. So the memory consumption depends on the size of a single chunk (max. 1MB
+	 * payload) and not on the total number of requested points.
+	 * Points not matching their configuration are skipped without stopping the transfer.
+	 * @param startTime Timestamp for start reading
+	 * @param count Number of recording points to be read beginning on startTime
+	 * @param points Output parameter that is increased by the number of points printed
+	 * @return OPC-UA Statuscode; BADDECODINGERROR if all points were read, but some were skipped
+	 */
+	UA_StatusCode streamByStartAndCount(const UA_DateTime& startTime, const uint32_t& count, uint64_t& points) const;
+
+	/**
+	 * Read, decode and print all points newer than a watermark up to endTime chunk by chunk.
+	 * Reading starts at the watermark, so points at the boundary that were already written by the
+	 * previous run are received again; these are dropped, so no point is printed twice.
+	 * Points not matching their configuration are skipped without stopping the transfer.
+	 * @param startTime Timestamp for start reading; usually the watermark or the start of the recording
+	 * @param endTime Timestamp for stop reading
+	 * @param watermark Input/Output parameter: Timestamp (UTC seconds) of the newest point already written.
+	 *        Updated to the newest point printed, also if reading fails afterwards.
+	 * @param points Output parameter that is increased by the number of points printed
+	 * @return OPC-UA Statuscode; BADDECODINGERROR if all points were read, but some were skipped
+	 */
+	UA_StatusCode readNewerThan(const UA_DateTime& startTime, const UA_DateTime& endTime, int64_t& watermark, uint64_t& points) const;
+
+	/**
+	 * Read all Recording Data between startTime and stopTime using multiple OPC-UA sessions in parallel.
+	 * The time range is split into shards holding roughly the same number of recording points
+	 * (determined by bisection with CountByRange). Each shard is fetched by its own session to the
+	 * same device, afterwards the shards are stitched together in timestamp order and decoded.
+	 * Points at the edges of a shard that are also delivered by the neighbouring shard are dropped.
+	 * The number of ReadByStartAndCount() calls running at the same time is limited by the
+	 * concurrency controller of the device, which adapts it to the observed latency.
+	 * @note For this example the resulting Data is just printed to STDOUT
+	 * @param startTime Timestamp for start reading
+	 * @param stopTime Timestamp for stop reading
+	 * @param shards Number of shards (and parallel sessions) to be used
+	 * @param points Output parameter that is increased by the number of points printed
+	 * @return OPC-UA Statuscode
+	 */
+	UA_StatusCode readByRangeSharded(const UA_DateTime& startTime, const UA_DateTime& stopTime, const unsigned& shards, uint64_t& points) const;
+
+	/**
+	 * Compare the number of points of a local copy with the device and find the intervals with missing points.
+	 * The time range is split into coarse buckets whose counts are requested all at once. Buckets with
+	 * fewer local points than on the device are bisected by CountByRange() until the intervals that are
+	 * completely missing locally (or are only one second wide) are found.
+	 * @param localTimes Sorted timestamps (UTC seconds) of the points held locally
+	 * @param startTime Start of the time range to be checked
+	 * @param endTime End of the time range to be checked
+	 * @param bucketSeconds Width of the coarse buckets
+	 * @param gaps Output parameter the found intervals are appended to in ascending order
 	 * @return OPC-UA Statuscode
 	 */
-	UA_StatusCode readByStartAndCount(const UA_DateTime& startTime, const uint32_t& count) const;
+	UA_StatusCode findGaps(const std::vector<int64_t>& localTimes, const UA_DateTime& startTime, const UA_DateTime& endTime,
+			const uint32_t& bucketSeconds, std::vector<RecordingGap>& gaps) const;
+
+	/**
+	 * Read, decode and print the points of the given intervals that are not held locally.
+	 * Points not matching their configuration are skipped without stopping the transfer.
+	 * @param localTimes Sorted timestamps (UTC seconds) of the points held locally
+	 * @param gaps Intervals to be read as returned by findGaps()
+	 * @param points Output parameter that is increased by the number of points printed
+	 * @return OPC-UA Statuscode; BADDECODINGERROR if all points were read, but some were skipped
+	 */
+	UA_StatusCode backfill(const std::vector<int64_t>& localTimes, const std::vector<RecordingGap>& gaps, uint64_t& points) const;
+
+	/**
+	 * Read, decode and print only the newest points of the recording.
+	 * The start time is estimated from the end of the available range and the interval of the
+	 * current RecordingConfiguration, refined by CountByRange() and afterwards exactly the
+	 * requested number of points is printed. So the latency does not depend on the history
+	 * stored on the device. Points not matching their configuration are skipped without stopping
+	 * the transfer.
+	 * @param count Number of newest points to be read
+	 * @param points Output parameter that is increased by the number of points printed
+	 * @return OPC-UA Statuscode; BADDECODINGERROR if all points were read, but some were skipped
+	 */
+	UA_StatusCode readTail(const uint32_t& count, uint64_t& points) const;
+
+	/**
+	 * Get the recording interval of the newest RecordingConfiguration
+	 * @param seconds Output parameter for the interval in seconds
+	 * @return OPC-UA Statuscode
+	 */
+	UA_StatusCode getInterval(uint32_t& seconds) const;
 
 	uint32_t getId() const;
 
+	/**
+	 * @return NodeId of the Data object of this recording
+	 */
+	const NodeId& getDataId() const;
+
 private:
 	/**
-	 * Internal Object to hold information about a single value from RecordingConfiguration
-	 * including belonging browsePath
+	 * Create a copy of a Recording that uses another client session to the same device.
+	 * All NodeIds are taken over, so no further browsing is necessary.
+	 * @param client Session the copy shall use for all OPC-UA-Communication
+	 * @param other Recording to be copied
 	 */
-	class RecordingValueInfo {
-	public:
-		RecordingValueInfo(const UA_RecordingValueInfo &i, const std::string &s) :
-				info(i), browsePath(s) {}
-		UA_RecordingValueInfo info;
-		std::string browsePath;
-	};
+	Recording(Umg801& client, const Recording& other);
 
 	/**
-	 * Internal Object to hold all information for mapping of values in Protobuffers
+	 * Fetch Recoding Data beginning on a certain Start-Time limited by a number of recording points
+	 * by subsequent calls to ReadByStartAndCount() without decoding it.
+	 * @param startTime Timestamp for start reading
+	 * @param count Number of recording points to be read beginning on startTime
+	 * @param data Output parameter the received recording points are appended to
+	 * @return OPC-UA Statuscode
 	 */
-	class RecordingConfiguration {
-	public:
-		RecordingConfiguration() :
-			id(0), algorithm(), extremals(), interval_seconds(), values() {}
-		uint32_t id;
-		UA_RecordingAlgorithm algorithm;
-		UA_RecordingExtremals extremals;
-		uint32_t interval_seconds;
-		std::vector<RecordingValueInfo> values;
-	};
+	UA_StatusCode fetchByStartAndCount(const UA_DateTime& startTime, const uint32_t& count, RecordedPoints& data) const;
 
-	/*
-	 * Print function to print a single measurement value of a recording point including its extremals
-	 * (sample/average + min;max;min_timestamp;max_timestamp)
-	 * @note The Output-format is pseudo JSON; You may want to use a JSON-Library here (omitted for less dependencies)
-	 * @param cfg belongingRecordingConfiguration to determine algorithm and extremals
-	 * @param protobuf Reference to the Protobuffer element the algorithm/extremal values shall be fetched from
-	 * @param index Reference to the index that is used to iterate through the values in the different protobuf value-type elements
-	 * @param browsename Browsename of the measurement
+	/**
+	 * Fetch Recoding Data beginning on a certain Start-Time limited by a number of recording points
+	 * and hand over every received chunk to a handler. The points left in a chunk or returned to
+	 * the spare list by the handler are reused for the next chunk, so their column buffers don't
+	 * have to be allocated again.
+	 * @param startTime Timestamp for start reading
+	 * @param count Number of recording points to be read beginning on startTime
+	 * @param handler Callback invoked for every chunk received from the device
+	 * @return OPC-UA Statuscode
 	 */
-	template<typename T>
-	void printProtobuf(RecordingConfiguration& cfg, const T& protobuf, size_t& index, const std::string& browsename) const;
+	UA_StatusCode fetchByStartAndCount(const UA_DateTime& startTime, const uint32_t& count, const ChunkHandler& handler) const;
+
+	/**
+	 * Get the configId and the data of a RecordingPoint received from the device, either decoded
+	 * by the client stack or still encoded (see OpcuaClient::setRawRecordingPoints())
+	 * @param e ExtensionObject holding the RecordingPoint
+	 * @param point Output parameter; its data points into e
+	 * @return false if e is not a valid RecordingPoint
+	 */
+	static bool getRecordingPoint(const UA_ExtensionObject& e, RecordingPointView& point);
+
+	/**
+	 * Do a single OPC-UA-RPC-Call to ReadByStartAndCount(). If the call fails, the session is reconnected
+	 * and the call is repeated with exponential backoff according to the retry policy of the client.
+	 * @param startTime Timestamp for start reading
+	 * @param count Number of recording points to be read beginning on startTime
+	 * @param outputSize Output parameter for the number of output arguments
+	 * @param output Output parameter for the output arguments; must be deleted by caller on success
+	 * @return OPC-UA Statuscode of the last attempt
+	 */
+	UA_StatusCode callReadByStartAndCount(const UA_DateTime& startTime, const uint32_t& count, size_t *outputSize, UA_Variant **output) const;
+
+	/**
+	 * Split a time range into shards with roughly the same number of recording points.
+	 * The boundaries are placed between two full seconds, so they never match the timestamp of a recording point.
+	 * @param startTime Start of the time range
+	 * @param stopTime End of the time range
+	 * @param count Number of recording points in the time range
+	 * @param shards Requested number of shards
+	 * @return Ascending boundaries beginning with startTime and ending with stopTime
+	 */
+	std::vector<UA_DateTime> splitRange(const UA_DateTime& startTime, const UA_DateTime& stopTime, const int& count, const unsigned& shards) const;
+
+	/**
+	 * Bisect an interval with a known number of points on the device until the parts missing locally are found.
+	 * @param localTimes Sorted timestamps (UTC seconds) of the points held locally
+	 * @param interval Interval to be checked, including the number of points on the device
+	 * @param gaps Output parameter the found intervals are appended to in ascending order
+	 * @return OPC-UA Statuscode
+	 */
+	UA_StatusCode bisectGap(const std::vector<int64_t>& localTimes, const RecordingGap& interval, std::vector<RecordingGap>& gaps) const;
+
+	/**
+	 * Count the local points within an interval. Interval boundaries are expected between two full seconds.
+	 */
+	static int countLocal(const std::vector<int64_t>& localTimes, const UA_DateTime& startTime, const UA_DateTime& endTime);
+
+
+	/**
+	 * Assign the channel ids of the device's ChannelDictionary to the values of a configuration
+	 * @param cfg Configuration
+	 */
+	void assignChannels(RecordingConfiguration& cfg) const;
 
 	/**
 	 * This method decodes the data received from device according to the referenced Recoding configuration.
 	 * Each recording point consists of a tuple of RecordingConfiguration-Id and a Bytestring representing a
 	 * Protobuffer that holds the actual timestamps, Measurement values and extremals.
-	 * This method reads the referenced Configuration and maps browsepaths with the values from the
-	 * protobuffer.
+	 * The referenced Configuration is taken from the cache filled at discovery (see readConfigurations()),
+	 * so decoding does not wait for OPC-UA-Communication. Only configurations created after the
+	 * discovery are read from the device on first use. Each configuration is compiled into a
+	 * DecodePlan on first use; points not matching their configuration are skipped.
+	 * @note The Output-format is pseudo JSON; You may want to use a JSON-Library here (omitted for less dependencies)
 	 * @param data List of Tuples with RecordingConfiguration-Id and Protobuffers holding the actual recorded measurement values
-	 * @return OPC-UA Statuscode
+	 * @param points Output parameter that is increased by the number of points printed
+	 * @return OPC-UA Statuscode; BADDECODINGERROR if points were skipped, BADNOTFOUND if a configuration
+	 *         could not be read (the points from there on are not printed)
+	 */
+	UA_StatusCode decodeData(const RecordedPoints& data, uint64_t& points) const;
+
+	/**
+	 * Same as decodeData(data, points), but also reports the newest point printed
+	 * @param newest Input/Output parameter: raised to the timestamp (UTC seconds) of the newest point printed
+	 */
+	UA_StatusCode decodeData(const RecordedPoints& data, uint64_t& points, int64_t& newest) const;
+
+	/**
+	 * Result of a chunk handler for the result of decodeData(): a skipped point does not stop
+	 * the transfer, because it would be skipped again on every retry
+	 * @param decoded Result of decodeData() for the chunk
+	 * @param skipped Output parameter; set if points of the chunk were skipped
+	 * @return GOOD if points were skipped, else decoded
+	 */
+	static UA_StatusCode skipMalformed(const UA_StatusCode& decoded, bool& skipped);
+
+	/**
+	 * Get a recording configuration from the cache of this Recording. If it is not cached yet,
+	 * it is read from the device. The cache lives as long as the Recording, so long running
+	 * sessions read each configuration only once.
+	 * @param id Id of the RecordingConfiguration
+	 * @return Pointer to the cached configuration; nullptr if it could not be read
+	 */
+	const RecordingConfiguration* getConfiguration(const uint32_t& id) const;
+
+	/**
+	 * Number of attributes read per RecordingConfiguration (Algorithm, Extremals, Interval, Values)
+	 */
+	static constexpr size_t ConfigurationAttributes = 4;
+
+	/**
+	 * Get the attributes to be read for a RecordingConfiguration
+	 * @param nodes Children of the RecordingConfiguration node
+	 * @return ConfigurationAttributes attributes in the order expected by parseConfiguration()
+	 */
+	static std::vector<OpcuaClient::AttributeRef> getConfigurationAttributes(const std::map<std::string, NodeId>& nodes);
+
+	/**
+	 * Fill a RecordingConfiguration from the result of a read of getConfigurationAttributes().
+	 * It also translates the NodeIds of configuration to the belonging browse-paths.
+	 * @param id Id of the RecordingConfiguration
+	 * @param result Result of the read
+	 * @param offset Index of the first attribute of this configuration in result
+	 * @param cfg Output parameter that is filled with the configuration
 	 */
-	UA_StatusCode decodeData(std::list<std::pair<uint32_t, records::RecordedData>>& data) const;
+	void parseConfiguration(const uint32_t& id, const OpcuaClient::ReadResult& result, const size_t& offset, RecordingConfiguration& cfg) const;
 
 	/**
 	 * This method reads a recording configuration from the device with a certain ID.
@@ -126,7 +449,9 @@ private:
 	NodeId m_getRangeId;
 	NodeId m_countByRangeId;
 	NodeId m_readByStartAndCountIdId;
-	std::map<uint32_t, NodeId> m_configIds;
+	/** Refreshed by readRecordingConfiguration() if a configuration was added after discovery */
+	mutable std::unordered_map<uint32_t, NodeId> m_configIds;
+	mutable RecordingConfigurations m_configs;
 };
 
 #endif /* RECORDING_HPP_ */
@@ -0,0 +1,126 @@
+/*
+ * SyncState.cpp
+ *
+ *  Created on: 17.10.2026
+ *   Copyright: 2026 by Janitza electronics GmbH
+ */
+
+#include "SyncState.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+SyncState::SyncState(const std::string& path) :
+	m_path(path),
+	m_mutex(),
+	m_watermarks() {}
+
+bool SyncState::load() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_watermarks.clear();
+	if(m_path.empty()) {
+		return true;
+	}
+	std::ifstream in(m_path);
+	if(!in) {
+		if(std::filesystem::exists(m_path)) {
+			std::cerr << "Failed to read sync state '" << m_path << "'" << std::endl;
+			return false;
+		}
+		return true;
+	}
+	std::string line;
+	while(std::getline(in, line)) {
+		std::istringstream fields(line);
+		std::string device;
+		uint32_t recordingId;
+		int64_t watermark;
+		if(fields >> device >> recordingId >> watermark) {
+			m_watermarks[{device, recordingId}] = watermark;
+		}
+	}
+	return true;
+}
+
+std::optional<int64_t> SyncState::getWatermark(const std::string& device, const uint32_t& recordingId) const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	const auto it = m_watermarks.find({device, recordingId});
+	if(it == m_watermarks.end()) {
+		return std::nullopt;
+	}
+	return it->second;
+}
+
+bool SyncState::commit(const std::string& device, const uint32_t& recordingId, const int64_t& watermark) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_watermarks[{device, recordingId}] = watermark;
+	return write();
+}
+
+bool SyncState::write() const {
+	if(m_path.empty()) {
+		return true;
+	}
+	std::ostringstream content;
+	for(const auto& w : m_watermarks) {
+		content << w.first.first << "\t" << w.first.second << "\t" << w.second << "\n";
+	}
+	const std::string data = content.str();
+
+	/* Write a temporary file, flush it to disk and rename it to the state file afterwards.
+	 * rename() is atomic on POSIX, so the state file is always complete.
+	 */
+	const std::string tmp = m_path + ".tmp";
+	const int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if(fd < 0) {
+		std::cerr << "Failed to write sync state '" << tmp << "': " << strerror(errno) << std::endl;
+		return false;
+	}
+	size_t written = 0;
+	while(written < data.size()) {
+		const ssize_t n = ::write(fd, data.data() + written, data.size() - written);
+		if(n < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+			std::cerr << "Failed to write sync state '" << tmp << "': " << strerror(errno) << std::endl;
+			::close(fd);
+			return false;
+		}
+		written += n;
+	}
+	const bool synced = (::fsync(fd) == 0);
+	::close(fd);
+	if(!synced || ::rename(tmp.c_str(), m_path.c_str()) != 0) {
+		std::cerr << "Failed to commit sync state '" << m_path << "': " << strerror(errno) << std::endl;
+		return false;
+	}
+	// Make the rename itself durable
+	std::filesystem::path dir = std::filesystem::path(m_path).parent_path();
+	return syncFile(dir.empty() ? "." : dir.string());
+}
+
+bool SyncState::syncFile(const std::string& path) {
+	const int fd = ::open(path.c_str(), O_RDONLY);
+	if(fd < 0) {
+		std::cerr << "Failed to open '" << path << "' for sync: " << strerror(errno) << std::endl;
+		return false;
+	}
+	const bool ret = syncFd(fd);
+	::close(fd);
+	return ret;
+}
+
+bool SyncState::syncFd(const int& fd) {
+	if(::fsync(fd) != 0 && errno != EINVAL && errno != EROFS) {
+		std::cerr << "Failed to sync file to disk: " << strerror(errno) << std::endl;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,77 @@
+/*
+ * SyncState.hpp
+ *
+ *  Created on: 17.10.2026
+ *   Copyright: 2026 by Janitza electronics GmbH
+ */
+
+#ifndef SYNCSTATE_HPP_
+#define SYNCSTATE_HPP_
+
+#include <string>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <cstdint>
+
+/**
+ * Durable watermarks for incremental synchronization of recordings.
+ * For each device and recording the timestamp (UTC seconds) of the newest point that was
+ * written to the output is stored in a local state file. The file is replaced atomically
+ * on commit, so a crash leaves either the old or the new state, never a partial one.
+ * All methods are thread-safe, so one state can be shared by all devices in fleet mode.
+ */
+class SyncState {
+public:
+	/**
+	 * @param path Path of the state file; an empty path keeps the watermarks in memory only
+	 */
+	explicit SyncState(const std::string& path = "");
+
+	/**
+	 * Load the state file. A missing file is treated as empty state.
+	 * @return false if the file exists but could not be read
+	 */
+	bool load();
+
+	/**
+	 * @param device Identifier of the device (its URL)
+	 * @param recordingId Id of the recording
+	 * @return Timestamp (UTC seconds) of the newest point already written or nullopt if never synchronized
+	 */
+	std::optional<int64_t> getWatermark(const std::string& device, const uint32_t& recordingId) const;
+
+	/**
+	 * Set the watermark of a recording and write the state file atomically.
+	 * Must only be called after the data up to the watermark has been written durably.
+	 * @param device Identifier of the device (its URL)
+	 * @param recordingId Id of the recording
+	 * @param watermark Timestamp (UTC seconds) of the newest point written
+	 * @return true on success
+	 */
+	bool commit(const std::string& device, const uint32_t& recordingId, const int64_t& watermark);
+
+	/**
+	 * Flush a file to disk.
+	 * @param path Path of the file
+	 * @return true on success
+	 */
+	static bool syncFile(const std::string& path);
+
+	/**
+	 * Flush an open file descriptor to disk. Descriptors that cannot be synced (e.g. pipes or terminals)
+	 * are treated as success, since there is nothing to be made durable.
+	 * @param fd File descriptor
+	 * @return true on success
+	 */
+	static bool syncFd(const int& fd);
+
+private:
+	bool write() const;
+
+	const std::string m_path;
+	mutable std::mutex m_mutex;
+	std::map<std::pair<std::string, uint32_t>, int64_t> m_watermarks;
+};
+
+#endif /* SYNCSTATE_HPP_ */
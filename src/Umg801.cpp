@@ -8,25 +8,178 @@
 #include "Umg801.hpp"
 
 #include <iostream>
+#include <algorithm>
+#include <climits>
+#include <thread>
+#include <ctime>
+#include <iomanip>
+#include <sstream>
 
 Umg801::Umg801() : OpcuaClient(),
-	m_lookupInfo() {
+	m_lookupInfo(),
+	m_lookupTables(),
+	m_pendingLookups(),
+	m_deviceId(),
+	m_lookupMethodId(),
+	m_metadataDir(),
+	m_channels(),
+	m_dictionaryOutput(true),
+	m_verifyDecoder(false),
+	m_snapshot(),
+	m_namespaces(),
+	m_snapshotValid(false),
+	m_concurrency(std::make_shared<ConcurrencyController>()) {
 }
 
 Umg801::~Umg801() {
 }
 
+ChannelDictionary& Umg801::channels() {
+	return m_channels;
+}
+
+void Umg801::setDictionaryOutput(const bool& enabled) {
+	m_dictionaryOutput = enabled;
+}
+
+void Umg801::setVerifyDecoder(const bool& enabled) {
+	m_verifyDecoder = enabled;
+}
+
+bool Umg801::getVerifyDecoder() const {
+	return m_verifyDecoder;
+}
+
+bool Umg801::getDictionaryOutput() const {
+	return m_dictionaryOutput;
+}
+
+void Umg801::setMetadataDir(const std::string& dir) {
+	m_metadataDir = dir;
+}
+
+bool Umg801::loadMetadata(const std::vector<std::string>& namespaces) {
+	if(m_snapshotValid) {
+		return true;
+	}
+	MetadataSnapshot snapshot;
+	const std::string file = MetadataSnapshot::fileName(m_metadataDir, getUrl());
+	if(namespaces.empty() || !snapshot.load(file)) {
+		return false;
+	}
+	if(snapshot.namespaces != namespaces) {
+		output() << "Metadata snapshot '" << file << "' is outdated" << std::endl;
+		return false;
+	}
+	m_nodeIdCache.insert(snapshot.browsePaths.begin(), snapshot.browsePaths.end());
+	m_browseCache.insert(snapshot.children.begin(), snapshot.children.end());
+	for(const auto& t : snapshot.lookup) {
+		for(const auto& l : t.second) {
+			m_lookupInfo.emplace(LookupKey{t.first, l.first}, l.second);
+		}
+		m_lookupTables.insert(t.first);
+	}
+	m_snapshot = std::move(snapshot);
+	m_snapshotValid = true;
+	output() << "Using metadata snapshot '" << file << "'" << std::endl;
+	return true;
+}
+
+bool Umg801::checkMetadata(const NodeId& recordingsNodeId) {
+	const auto matches = [this](const NodeId& node, const std::map<std::string, NodeId>& children) {
+		const auto it = m_snapshot.children.find(node);
+		return it != m_snapshot.children.end() && it->second == children;
+	};
+	// New recordings show up in the Recordings folder, new configurations in their recording
+	const auto folder = getHierarichalNodes(std::vector<NodeId>{recordingsNodeId}).front();
+	bool valid = matches(recordingsNodeId, folder);
+	if(valid) {
+		std::vector<NodeId> nodes;
+		for(const auto& n : folder) {
+			if(OpcUaUtil::isPrefix(n.first, "Recording")) {
+				nodes.push_back(n.second);
+			}
+		}
+		const auto children = getHierarichalNodes(nodes);
+		for(size_t i = 0; valid && i < nodes.size(); i++) {
+			valid = matches(nodes[i], children[i]);
+		}
+	}
+	if(!valid) {
+		output() << "Metadata snapshot '" << MetadataSnapshot::fileName(m_metadataDir, getUrl())
+				<< "' is outdated" << std::endl;
+		m_snapshot = MetadataSnapshot();
+		m_snapshotValid = false;
+	}
+	return valid;
+}
+
+void Umg801::saveMetadata(const std::list<Recording>& recordings) {
+	if(m_namespaces.empty()) {
+		return;
+	}
+	MetadataSnapshot snapshot;
+	snapshot.namespaces = m_namespaces;
+	snapshot.browsePaths = m_nodeIdCache;
+	snapshot.children = m_browseCache;
+	for(const auto& t : m_lookupTables) {
+		snapshot.lookup[t]; // complete table, even if empty
+	}
+	for(const auto& l : m_lookupInfo) {
+		snapshot.lookup[l.first.tag].emplace(l.first.nodeId, l.second);
+	}
+	for(const auto& r : recordings) {
+		snapshot.configurations[r.getId()] = r.getConfigurations();
+	}
+	// The caches only grow, so an unchanged number of entries means nothing new was read
+	if(m_snapshotValid && snapshot.entries() <= m_snapshot.entries()) {
+		return;
+	}
+	if(snapshot.save(MetadataSnapshot::fileName(m_metadataDir, getUrl()))) {
+		m_snapshot = std::move(snapshot);
+		m_snapshotValid = true;
+	}
+}
+
 std::list<Recording> Umg801::getRecordings() {
 	std::list<Recording> recordings;
-	NodeId recordingsNodeId = browsePathToNodeId(NodeId(0, UA_NS0ID_OBJECTSFOLDER),
-			{{2,"Device", UA_NS0ID_ORGANIZES},
-			 {2,"Recordings", UA_NS0ID_HASCOMPONENT}});
+	/* A valid metadata snapshot replaces the whole discovery; validating it against the
+	 * NamespaceArray and the recordings of the device takes a Read and two Browse requests.
+	 */
+	m_namespaces.clear();
+	if(!m_metadataDir.empty()) {
+		const ReadResult result = readAttributes({{NodeId(0, UA_NS0ID_SERVER_NAMESPACEARRAY)}});
+		for(const auto& ns : result.getArrayValue<UA_String>(0)) {
+			m_namespaces.push_back(OpcUaUtil::toString(ns));
+		}
+	}
+	bool cached = loadMetadata(m_namespaces);
+
+	/* Resolve every path needed during the readout with one request: the Recordings folder,
+	 * the Lookup method of the device and the methods shared by all recordings.
+	 */
+	std::vector<BrowsePath> paths = {
+			{NodeId(0, UA_NS0ID_OBJECTSFOLDER), {{2,"Device", UA_NS0ID_ORGANIZES}, {2,"Recordings", UA_NS0ID_HASCOMPONENT}}},
+			{NodeId(0, UA_NS0ID_OBJECTSFOLDER), {{2,"Device", UA_NS0ID_ORGANIZES}}},
+			{NodeId(0, UA_NS0ID_OBJECTSFOLDER), {{2,"Device", UA_NS0ID_ORGANIZES}, {2,"Lookup", UA_NS0ID_HASCOMPONENT}}}};
+	for(const auto& p : Recording::getMethodPaths()) {
+		paths.push_back(p);
+	}
+	const NodeId recordingsNodeId = browsePathsToNodeIds(paths).front();
 	if(recordingsNodeId.isNull()) {
 		std::cerr << "Node-ID of Node /Objects/Device/Recordings not found!" << std::endl;
 	} else {
-		for (const auto& n : getHierarichalNodes(recordingsNodeId)) {
+		/* Crawl Recordings/RecordingN/RecordingConfigurationM with one Browse request per level;
+		 * Recording::getNodeIds() and the configuration reads are served from this snapshot.
+		 */
+		cached = cached && checkMetadata(recordingsNodeId);
+		auto snapshot = cached ? m_browseCache : browseSubtree(recordingsNodeId, {"Recording", "RecordingConfiguration"});
+		for (const auto& n : snapshot[recordingsNodeId]) {
 			if(OpcUaUtil::isPrefix(n.first, "Recording")) {
 				auto rec = Recording(*this, OpcUaUtil::getIdSuffix(n.first), n.second);
+				if(cached) {
+					rec.addConfigurations(m_snapshot.configurations[rec.getId()]);
+				}
 				if(rec.getNodeIds() == UA_STATUSCODE_GOOD) {
 					recordings.emplace_back(rec);
 				} else {
@@ -34,47 +187,499 @@ std::list<Recording> Umg801::getRecordings() {
 				}
 			}
 		}
+		// Load the configurations of all recordings with one request
+		if(Recording::readConfigurations(recordings) != UA_STATUSCODE_GOOD) {
+			std::cerr << "Reading RecordingConfigurations failed; they are read on demand" << std::endl;
+		} else {
+			saveMetadata(recordings);
+		}
 	}
 	return recordings;
 }
 
-std::optional<std::string> Umg801::lookup(const NodeId& id, const UA_Tag& tag) {
-	UA_StatusCode retval = UA_STATUSCODE_GOOD;
-	auto ret = m_lookupInfo.find(id);
-	if(ret == m_lookupInfo.end()) {
-		// NodeId not found in cache, to a new request!
-		const NodeId deviceId = browsePathToNodeId(NodeId(0, UA_NS0ID_OBJECTSFOLDER), {{2,"Device", UA_NS0ID_ORGANIZES}});
-		if(deviceId.isNull()) {
-			std::cerr << "Node Objects/Device could not be found!" << std::endl;
-			return std::nullopt;
-		}
-		const NodeId lookupId = browsePathToNodeId(deviceId, {{2,"Lookup", UA_NS0ID_HASCOMPONENT}});
-		if(lookupId.isNull()) {
-			std::cerr << "Method-Node Objects/Device/Lookup could not be found!" << std::endl;
-			return std::nullopt;
-		}
-		UA_Variant input;
-		UA_Variant_init(&input);
-		UA_Variant_setScalarCopy(&input, &tag, &UA_TYPES[UA_TYPES_INT32]);
-		size_t outputSize;
-		UA_Variant *output;
-		retval = clientCall(deviceId, lookupId, 1, &input, &outputSize, &output);
-		if(retval != UA_STATUSCODE_GOOD) {
-			std::cerr << "Method call to Lookup was unsuccessful: " << UA_StatusCode_name(retval) << std::endl;
+std::map<uint32_t, RecordingRange> Umg801::getRanges(const std::list<Recording>& recordings) {
+	std::map<uint32_t, RecordingRange> ranges;
+	std::vector<std::future<CallResult>> pending;
+
+	for(const auto& r : recordings) {
+		pending.emplace_back(r.getRangeAsync());
+	}
+	auto p = pending.begin();
+	for(const auto& r : recordings) {
+		const CallResult result = await(*p++);
+		RecordingRange& range = ranges[r.getId()];
+		range.status = r.getRange(result, range.startTime, range.endTime);
+		range.count = -1;
+	}
+
+	pending.clear();
+	for(const auto& r : recordings) {
+		const RecordingRange& range = ranges[r.getId()];
+		if(range.status == UA_STATUSCODE_GOOD) {
+			pending.emplace_back(r.countByRangeAsync(range.startTime, range.endTime));
 		} else {
-			UA_ExtensionObject* e = (UA_ExtensionObject*) output[0].data;
-			for(size_t i=0; i < output[0].arrayLength; i++) {
-				UA_LookupInfo* info = (UA_LookupInfo*) e[i].content.decoded.data;
-				m_lookupInfo.emplace(NodeId(info->nodeId), OpcUaUtil::toString(info->browsePath));
-				info++;
+			pending.emplace_back();
+		}
+	}
+	p = pending.begin();
+	for(const auto& r : recordings) {
+		auto& future = *p++;
+		if(future.valid()) {
+			RecordingRange& range = ranges[r.getId()];
+			range.count = r.countByRange(await(future));
+			if(range.count < 0) {
+				range.status = UA_STATUSCODE_BADINTERNALERROR;
+			}
+		}
+	}
+
+	return ranges;
+}
+
+ConcurrencyController& Umg801::concurrency() const {
+	return *m_concurrency;
+}
+
+void Umg801::shareConcurrency(const Umg801& other) {
+	m_concurrency = other.m_concurrency;
+}
+
+ReadoutSummary Umg801::readout(const ReadoutOptions& options) {
+	ReadoutSummary summary;
+	m_concurrency->setCeiling(options.maxParallel > 0 ? options.maxParallel : options.shards);
+	const auto recordings = getRecordings();
+	/* Without sync state this example just fetches all data, so we grab overall time range from device.
+	 * The ranges of all recordings are requested at once to save round trips.
+	 */
+	const auto ranges = getRanges(recordings);
+	for (const auto& r : recordings) {
+		const RecordingRange& range = ranges.at(r.getId());
+		if(range.status != UA_STATUSCODE_GOOD) {
+			continue;
+		}
+		summary.recordings++;
+		UA_StatusCode retval = UA_STATUSCODE_GOOD;
+		if(options.tail > 0) {
+			retval = r.readTail(options.tail, summary.points);
+		} else if(options.syncState) {
+			retval = sync(r, range, options, summary);
+		} else if(range.count > 0) {
+			output() << "Found Recording " << r.getId() << " with " << range.count << " Points between "
+					<< OpcUaUtil::dateTimeToString(range.startTime) << " and " << OpcUaUtil::dateTimeToString(range.endTime) << std::endl;
+			if(options.shards > 1) {
+				retval = r.readByRangeSharded(range.startTime, range.endTime, options.shards, summary.points);
+			} else if(options.streaming) {
+				retval = r.streamByStartAndCount(range.startTime, range.count, summary.points);
+			} else {
+				retval = r.readByStartAndCount(range.startTime, range.count, summary.points);
+			}
+		}
+		if(retval != UA_STATUSCODE_GOOD && summary.status == UA_STATUSCODE_GOOD) {
+			summary.status = retval;
+		}
+	}
+	// Configurations read on demand are kept for the next start
+	saveMetadata(recordings);
+	return summary;
+}
+
+ReadoutSummary Umg801::follow(const ReadoutOptions& options, const std::atomic<bool>& running) {
+	struct Poll {
+		const Recording* recording;
+		UA_DateTime interval;
+		UA_DateTime due;
+		bool subscribed;
+	};
+	ReadoutSummary summary;
+	SyncState memoryState;
+	ReadoutOptions followOptions = options;
+	if(!followOptions.syncState) {
+		followOptions.syncState = &memoryState;
+	}
+
+	const auto recordings = getRecordings();
+	const auto ranges = getRanges(recordings);
+	std::vector<Poll> polls;
+	for(const auto& r : recordings) {
+		uint32_t seconds;
+		const RecordingRange& range = ranges.at(r.getId());
+		if(range.status != UA_STATUSCODE_GOOD || r.getInterval(seconds) != UA_STATUSCODE_GOOD) {
+			std::cerr << "Skipping Recording" << r.getId() << std::endl;
+			continue;
+		}
+		if(!options.syncState) {
+			// Only points recorded from now on are of interest
+			memoryState.commit(getUrl(), r.getId(), OpcUaUtil::dateTimeToUnixTime(range.endTime));
+		}
+		const UA_DateTime interval = std::max<UA_DateTime>(1, seconds) * UA_DATETIME_SEC;
+		polls.push_back({&r, interval, nextPoll(UA_DateTime_now(), interval), false});
+	}
+	summary.recordings = polls.size();
+	if(polls.empty()) {
+		summary.status = UA_STATUSCODE_BADNOTFOUND;
+		return summary;
+	}
+
+	if(options.subscribe) {
+		/* Data is an Object without a Value attribute, so it can only be monitored for events.
+		 * Recordings whose Data node is no event notifier, or whose event item can not be
+		 * created, keep being polled. The EventNotifier attributes are read with one request.
+		 */
+		std::vector<AttributeRef> attributes;
+		for(const auto& p : polls) {
+			attributes.push_back({p.recording->getDataId(), UA_ATTRIBUTEID_EVENTNOTIFIER});
+		}
+		const ReadResult notifiers = readAttributes(attributes);
+		std::vector<NodeId> nodes;
+		std::vector<size_t> monitored; // index of the poll of each node
+		for(size_t i = 0; i < polls.size(); i++) {
+			if(notifiers.getValue<UA_Byte>(i) & UA_EVENTNOTIFIER_SUBSCRIBE_TO_EVENT) {
+				nodes.push_back(polls[i].recording->getDataId());
+				monitored.push_back(i);
+			} else {
+				std::cerr << "Recording" << polls[i].recording->getId() << " does not notify events; polling it" << std::endl;
+			}
+		}
+		if(!nodes.empty()) {
+			const auto statuses = subscribeEvents(nodes, SubscriptionInterval, [&polls, &monitored](size_t i) {
+				if(i < monitored.size()) {
+					polls[monitored[i]].due = UA_DateTime_now();
+				}
+			});
+			for(size_t i = 0; i < nodes.size(); i++) {
+				Poll& p = polls[monitored[i]];
+				p.subscribed = (statuses[i] == UA_STATUSCODE_GOOD);
+				if(p.subscribed) {
+					p.due = UA_DateTime_now() + SafetyPollFactor * p.interval;
+				} else {
+					std::cerr << "Recording" << p.recording->getId() << " can not be monitored ("
+							<< UA_StatusCode_name(statuses[i]) << "); polling it" << std::endl;
+				}
+			}
+		}
+	}
+
+	while(running) {
+		auto poll = std::min_element(polls.begin(), polls.end(), [](const Poll& a, const Poll& b) { return a.due < b.due; });
+		// Keep the session alive (and receive notifications) while waiting for the next poll
+		for(UA_DateTime now = UA_DateTime_now(); running && now < poll->due; now = UA_DateTime_now()) {
+			const UA_DateTime wait = std::min<UA_DateTime>(poll->due - now, 500 * UA_DATETIME_MSEC);
+			if(runIterate(wait / UA_DATETIME_MSEC) != UA_STATUSCODE_GOOD) {
+				std::this_thread::sleep_for(getRetryPolicy().initialBackoff);
+				if(!reconnect()) {
+					std::cerr << "Reconnect to " << getUrl() << " failed" << std::endl;
+				}
 			}
-			UA_Array_delete(output, outputSize, &UA_TYPES[UA_TYPES_VARIANT]);
+			// A notification may have made another recording due earlier
+			poll = std::min_element(polls.begin(), polls.end(), [](const Poll& a, const Poll& b) { return a.due < b.due; });
 		}
-		UA_Variant_clear(&input);
+		if(!running) {
+			break;
+		}
+
+		RecordingRange range;
+		range.status = poll->recording->getRange(range.startTime, range.endTime);
+		UA_StatusCode retval = range.status;
+		if(retval == UA_STATUSCODE_GOOD) {
+			retval = sync(*poll->recording, range, followOptions, summary);
+		} else if(!reconnect()) {
+			std::cerr << "Reconnect to " << getUrl() << " failed" << std::endl;
+		}
+		// The first failure is kept, even if later polls succeed
+		if(retval != UA_STATUSCODE_GOOD && summary.status == UA_STATUSCODE_GOOD) {
+			summary.status = retval;
+		}
+		if(poll->subscribed) {
+			// Polled anyway after a long time, in case a notification got lost
+			poll->due = UA_DateTime_now() + SafetyPollFactor * poll->interval;
+		} else {
+			poll->due = nextPoll(UA_DateTime_now(), poll->interval);
+		}
+	}
+	if(options.subscribe) {
+		unsubscribe();
+	}
+	saveMetadata(recordings);
+	return summary;
+}
+
+UA_DateTime Umg801::nextPoll(const UA_DateTime& now, const UA_DateTime& interval) {
+	const UA_DateTime sinceEpoch = now - FollowDelay - UA_DATETIME_UNIX_EPOCH;
+	return UA_DATETIME_UNIX_EPOCH + (sinceEpoch / interval + 1) * interval + FollowDelay;
+}
+
+ReadoutSummary Umg801::reconcile(const uint32_t& recordingId, std::vector<int64_t> localTimes, const uint32_t& bucketSeconds) {
+	ReadoutSummary summary;
+	std::sort(localTimes.begin(), localTimes.end());
+
+	const auto recordings = getRecordings();
+	for(const auto& r : recordings) {
+		if(r.getId() != recordingId) {
+			continue;
+		}
+		summary.recordings++;
+		UA_DateTime startTime, endTime;
+		summary.status = r.getRange(startTime, endTime);
+		if(summary.status != UA_STATUSCODE_GOOD) {
+			return summary;
+		}
+		std::vector<RecordingGap> gaps;
+		summary.status = r.findGaps(localTimes, startTime, endTime, bucketSeconds, gaps);
+		if(summary.status != UA_STATUSCODE_GOOD) {
+			return summary;
+		}
+		for(const auto& g : gaps) {
+			output() << "Found gap of " << g.count << " Points in Recording " << recordingId << " between "
+					<< OpcUaUtil::dateTimeToString(g.startTime) << " and " << OpcUaUtil::dateTimeToString(g.endTime) << std::endl;
+		}
+		summary.status = r.backfill(localTimes, gaps, summary.points);
+		saveMetadata(recordings);
+		return summary;
+	}
+
+	std::cerr << "Recording" << recordingId << " not found!" << std::endl;
+	summary.status = UA_STATUSCODE_BADNOTFOUND;
+	return summary;
+}
+
+UA_StatusCode Umg801::sync(const Recording& recording, const RecordingRange& range, const ReadoutOptions& options, ReadoutSummary& summary) {
+	const auto stored = options.syncState->getWatermark(getUrl(), recording.getId());
+	/* Start at the watermark, or at the oldest point if the recording was never synchronized.
+	 * If the device dropped data older than the watermark in the meantime, start at the oldest point.
+	 */
+	int64_t watermark = stored ? *stored : INT64_MIN;
+	UA_DateTime startTime = range.startTime;
+	if(stored) {
+		startTime = std::max(startTime, OpcUaUtil::unixTimeToDateTime(*stored));
+	}
+	if(startTime > range.endTime || (stored && OpcUaUtil::dateTimeToUnixTime(range.endTime) <= *stored)) {
+		return UA_STATUSCODE_GOOD; // nothing new
 	}
-	ret = m_lookupInfo.find(id);
+	output() << "Syncing Recording " << recording.getId() << " between "
+			<< OpcUaUtil::dateTimeToString(startTime) << " and " << OpcUaUtil::dateTimeToString(range.endTime) << std::endl;
+
+	const UA_StatusCode retval = recording.readNewerThan(startTime, range.endTime, watermark, summary.points);
+
+	// Commit whatever was written, also if the transfer failed later on
+	if(watermark > (stored ? *stored : INT64_MIN)) {
+		output().flush();
+		if(options.makeDurable && !options.makeDurable()) {
+			std::cerr << "Failed to write data of Recording" << recording.getId() << " durably; watermark not committed" << std::endl;
+			return UA_STATUSCODE_BADINTERNALERROR;
+		}
+		if(!options.syncState->commit(getUrl(), recording.getId(), watermark)) {
+			return UA_STATUSCODE_BADINTERNALERROR;
+		}
+	}
+	return retval;
+}
+
+std::optional<std::string> Umg801::lookup(const NodeId& id, const UA_Tag& tag) {
+	fetchLookupTable(tag);
+	const auto ret = m_lookupInfo.find({tag, id});
 	if(ret != m_lookupInfo.end()) {
 		return ret->second;
 	}
 	return std::nullopt;
 }
+
+UA_StatusCode Umg801::fetchLookupTable(const UA_Tag& tag) {
+	if(m_lookupTables.find(tag) != m_lookupTables.end()) {
+		return UA_STATUSCODE_GOOD;
+	}
+	auto pending = m_pendingLookups.find(tag);
+	if(pending == m_pendingLookups.end()) {
+		prefetchLookupTable(tag);
+		pending = m_pendingLookups.find(tag);
+		if(pending == m_pendingLookups.end()) {
+			return UA_STATUSCODE_BADNOTFOUND;
+		}
+	}
+	const UA_StatusCode retval = storeLookupTable(tag, await(pending->second));
+	m_pendingLookups.erase(pending);
+	// Only a complete table is cached; after a failed transfer the next lookup tries again
+	if(retval == UA_STATUSCODE_GOOD) {
+		m_lookupTables.insert(tag);
+	}
+	return retval;
+}
+
+std::vector<std::pair<NodeId, std::string>> Umg801::getLookupTable(const UA_Tag& tag) {
+	std::vector<std::pair<NodeId, std::string>> table;
+	if(fetchLookupTable(tag) != UA_STATUSCODE_GOOD) {
+		return table;
+	}
+	for(const auto& l : m_lookupInfo) {
+		if(l.first.tag == tag) {
+			table.emplace_back(l.first.nodeId, l.second);
+		}
+	}
+	std::sort(table.begin(), table.end(), [](const auto& a, const auto& b) { return a.second < b.second; });
+	return table;
+}
+
+std::vector<std::pair<NodeId, std::string>> Umg801::getLiveNodes(const std::vector<UA_Tag>& tags) {
+	for(const auto& tag : tags) {
+		// Fetch all tables concurrently
+		prefetchLookupTable(tag);
+	}
+	std::vector<std::pair<NodeId, std::string>> nodes;
+	for(const auto& tag : tags) {
+		const auto table = getLookupTable(tag);
+		nodes.insert(nodes.end(), table.begin(), table.end());
+	}
+	return nodes;
+}
+
+void Umg801::printTime(const UA_DateTime& t) const {
+	const std::time_t time = OpcUaUtil::dateTimeToUnixTime(t);
+	std::tm local;
+	output() << "{ \"time\" : \"" << std::put_time(localtime_r(&time, &local), "%Y-%m-%d %X") << "\"" << std::endl;
+}
+
+void Umg801::printLiveValue(std::ostream& out, const std::string& name, const UA_DataValue& value) {
+	if(m_dictionaryOutput) {
+		// The channel definition precedes the block holding the value
+		const uint32_t channel = m_channels.getChannel(name);
+		m_channels.emit(output(), channel);
+		out << "\"" << channel << "\" : { ";
+	} else {
+		out << "\"" << name << "\" : { ";
+	}
+	if(value.hasStatus && value.status != UA_STATUSCODE_GOOD) {
+		out << "\"status\" : \"" << UA_StatusCode_name(value.status) << "\" ";
+	} else {
+		out << "\"value\" : " << OpcUaUtil::variantToString(value.value) << " ";
+	}
+	if(value.hasSourceTimestamp) {
+		out << ", \"source_time\" : " << OpcUaUtil::dateTimeToUnixTime(value.sourceTimestamp) << " ";
+	}
+	out << " }, " << std::endl;
+}
+
+ReadoutSummary Umg801::readLiveValues(const std::vector<UA_Tag>& tags) {
+	ReadoutSummary summary;
+	const auto nodes = getLiveNodes(tags);
+	if(nodes.empty()) {
+		summary.status = UA_STATUSCODE_BADNOTFOUND;
+		return summary;
+	}
+	std::vector<AttributeRef> attributes;
+	attributes.reserve(nodes.size());
+	for(const auto& n : nodes) {
+		attributes.push_back({n.first});
+	}
+	const UA_DateTime now = UA_DateTime_now();
+	const ReadResult result = readAttributes(attributes, UA_TIMESTAMPSTORETURN_SOURCE);
+	summary.status = result.status;
+	if(result.status != UA_STATUSCODE_GOOD) {
+		return summary;
+	}
+	// Emit the channel definitions before the block
+	std::ostringstream values;
+	for(size_t i = 0; i < nodes.size(); i++) {
+		printLiveValue(values, nodes[i].second, result.values[i]);
+	}
+	printTime(now);
+	output() << values.str();
+	output() << "}," << std::endl;
+	summary.points = nodes.size();
+	return summary;
+}
+
+ReadoutSummary Umg801::watchLiveValues(const std::vector<UA_Tag>& tags, const double& samplingInterval, const std::atomic<bool>& running) {
+	ReadoutSummary summary;
+	const auto nodes = getLiveNodes(tags);
+	if(nodes.empty()) {
+		summary.status = UA_STATUSCODE_BADNOTFOUND;
+		return summary;
+	}
+	std::vector<NodeId> ids;
+	ids.reserve(nodes.size());
+	for(const auto& n : nodes) {
+		ids.push_back(n.first);
+	}
+	// The changes received by one iteration are collected and printed as one block
+	std::ostringstream changes;
+	const auto statuses = subscribeDataChanges(ids, samplingInterval,
+			[this, &nodes, &summary, &changes](size_t i, const UA_DataValue& value) {
+		printLiveValue(changes, nodes.at(i).second, value);
+		summary.points++;
+	}, samplingInterval);
+	size_t monitored = 0;
+	for(size_t i = 0; i < statuses.size(); i++) {
+		if(statuses[i] == UA_STATUSCODE_GOOD) {
+			monitored++;
+		} else {
+			std::cerr << "'" << nodes[i].second << "' can not be monitored: " << UA_StatusCode_name(statuses[i]) << std::endl;
+		}
+	}
+	if(monitored == 0) {
+		unsubscribe();
+		summary.status = UA_STATUSCODE_BADNOTFOUND;
+		return summary;
+	}
+	output() << "Monitoring " << monitored << " values" << std::endl;
+
+	while(running) {
+		if(runIterate(500) != UA_STATUSCODE_GOOD) {
+			std::this_thread::sleep_for(getRetryPolicy().initialBackoff);
+			if(!reconnect()) {
+				std::cerr << "Reconnect to " << getUrl() << " failed" << std::endl;
+			}
+		}
+		if(changes.tellp() > 0) {
+			printTime(UA_DateTime_now());
+			output() << changes.str() << "}," << std::endl;
+			changes.str("");
+		}
+	}
+	unsubscribe();
+	return summary;
+}
+
+void Umg801::prefetchLookupTable(const UA_Tag& tag) {
+	if(m_lookupTables.find(tag) != m_lookupTables.end() || m_pendingLookups.find(tag) != m_pendingLookups.end()) {
+		return;
+	}
+	if(m_deviceId.isNull() || m_lookupMethodId.isNull()) {
+		const std::vector<NodeId> ids = browsePathsToNodeIds({
+				{NodeId(0, UA_NS0ID_OBJECTSFOLDER), {{2,"Device", UA_NS0ID_ORGANIZES}}},
+				{NodeId(0, UA_NS0ID_OBJECTSFOLDER), {{2,"Device", UA_NS0ID_ORGANIZES}, {2,"Lookup", UA_NS0ID_HASCOMPONENT}}}});
+		m_deviceId = ids[0];
+		m_lookupMethodId = ids[1];
+		if(m_deviceId.isNull()) {
+			std::cerr << "Node Objects/Device could not be found!" << std::endl;
+			return;
+		}
+		if(m_lookupMethodId.isNull()) {
+			std::cerr << "Method-Node Objects/Device/Lookup could not be found!" << std::endl;
+			return;
+		}
+	}
+	UA_Variant input;
+	UA_Variant_init(&input);
+	UA_Variant_setScalarCopy(&input, &tag, &UA_TYPES[UA_TYPES_INT32]);
+	m_pendingLookups.emplace(tag, clientCallAsync(m_deviceId, m_lookupMethodId, 1, &input));
+	UA_Variant_clear(&input);
+}
+
+UA_StatusCode Umg801::storeLookupTable(const UA_Tag& tag, const CallResult& result) {
+	if(result.status != UA_STATUSCODE_GOOD) {
+		std::cerr << "Method call to Lookup was unsuccessful: " << UA_StatusCode_name(result.status) << std::endl;
+		return result.status;
+	}
+	if(result.outputSize < 1) {
+		return UA_STATUSCODE_BADUNEXPECTEDERROR;
+	}
+	UA_ExtensionObject* e = (UA_ExtensionObject*) result.output[0].data;
+	for(size_t i=0; i < result.output[0].arrayLength; i++) {
+		if(e[i].encoding < UA_EXTENSIONOBJECT_DECODED) {
+			std::cerr << "Unknown type!" << std::endl;
+			continue;
+		}
+		const UA_LookupInfo* info = (const UA_LookupInfo*) e[i].content.decoded.data;
+		m_lookupInfo.emplace(LookupKey{tag, NodeId(info->nodeId)}, OpcUaUtil::toString(info->browsePath));
+	}
+	return UA_STATUSCODE_GOOD;
+}
@@ -11,32 +11,319 @@
 
 #include "OpcuaClient.hpp"
 #include "Recording.hpp"
+#include "ConcurrencyController.hpp"
+#include "SyncState.hpp"
+#include "MetadataSnapshot.hpp"
+#include "ChannelDictionary.hpp"
 
 #include <map>
+#include <set>
+#include <unordered_map>
 #include <list>
 #include <string>
 #include <optional>
+#include <memory>
+#include <functional>
+#include <atomic>
+#include <vector>
+#include <utility>
+
+/**
+ * Options for reading out all recordings of a device
+ */
+struct ReadoutOptions {
+	unsigned shards = 1;
+	/**
+	 * Maximum number of ReadByStartAndCount() calls outstanding at the same time across the shard
+	 * sessions of a recording; 0 means one per shard. Each shard has at most one call outstanding,
+	 * so the limit only matters below the number of shards. The pipelined GetRange() and
+	 * CountByRange() calls of a single session are not limited.
+	 */
+	unsigned maxParallel = 0;
+	bool streaming = false;
+	/** Only read the given number of newest points of each recording; 0 reads all */
+	uint32_t tail = 0;
+	/** Watermarks for incremental synchronization; if not set, all available data is read */
+	SyncState* syncState = nullptr;
+	/** Makes the output written so far durable; called before a watermark is committed */
+	std::function<bool()> makeDurable;
+	/** Directory of the per-device metadata snapshots; empty disables them */
+	std::string metadataDir;
+	/** Follow mode: wait for events of the Data node of the recordings that emit them instead of polling */
+	bool subscribe = false;
+	/** Refer to values by channel id instead of printing their browse path in every point */
+	bool channelDictionary = true;
+	/** Decode every recording point with the protobuf library as well and report differences */
+	bool verifyDecoder = false;
+	/** Leave RecordingPoints encoded by the client stack (see OpcuaClient::setRawRecordingPoints()) */
+	bool rawRecordingPoints = false;
+};
+
+/**
+ * Result of reading out all recordings of a device
+ */
+struct ReadoutSummary {
+	UA_StatusCode status = UA_STATUSCODE_GOOD;
+	size_t recordings = 0;
+	uint64_t points = 0;
+};
+
+/**
+ * Key of a lookup result: the same node may be looked up in the tables of different tags
+ */
+struct LookupKey {
+	UA_Tag tag;
+	NodeId nodeId;
+	bool operator==(const LookupKey& other) const {
+		return tag == other.tag && nodeId == other.nodeId;
+	}
+};
+
+struct LookupKeyHash {
+	std::size_t operator()(const LookupKey& key) const {
+		return key.nodeId.hash() ^ (std::size_t(key.tag) << 24);
+	}
+};
 
 class Umg801 : public OpcuaClient {
 public:
 	Umg801();
 	virtual ~Umg801();
 
+	/**
+	 * Discover all recordings of the device including their RecordingConfigurations.
+	 * If a metadata directory is set, a valid snapshot of the device replaces the discovery,
+	 * otherwise a new snapshot is written after the discovery.
+	 * @return Recordings of the device
+	 */
 	std::list<Recording> getRecordings();
 
 	/**
-	 * Lookup a browsepath to a given NodeId. This is done by a RPC-Call to /Objects/Device/Loopup().
-	 * The Results of this method are stored to a Cache, so subsequent calls will not lead to
-	 * OPC-UA-Communication.
+	 * Set the directory of the metadata snapshots (see MetadataSnapshot)
+	 * @param dir Directory; empty disables the snapshots
+	 */
+	void setMetadataDir(const std::string& dir);
+
+	/**
+	 * Determine time range and number of points of multiple recordings.
+	 * All GetRange() calls are sent at once, followed by all CountByRange() calls, so the network
+	 * round trips overlap instead of adding up.
+	 * @param recordings Recordings to be queried
+	 * @return Map of Recording-Id to its range. On error the status of the range is set accordingly.
+	 */
+	std::map<uint32_t, RecordingRange> getRanges(const std::list<Recording>& recordings);
+
+	/**
+	 * Read all available data of all recordings of the device and print it to the output of the client.
+	 * @param options Options how the recordings shall be read
+	 * @return Summary of the readout; status is the first error that occurred
+	 */
+	ReadoutSummary readout(const ReadoutOptions& options);
+
+	/**
+	 * Keep the session open and poll each recording for new points until stopped.
+	 * The polls are aligned to the interval of the newest RecordingConfiguration of each recording
+	 * (plus a short delay, so the device finished storing the point), and only points that were
+	 * not printed before are printed. All caches (NodeIds, lookups, configurations) stay warm
+	 * between the polls. Without sync state in the options only points recorded after the start
+	 * are printed; with sync state the watermarks are taken from and committed to it.
+	 * With the subscribe option a recording is read as soon as its Data node emits an event;
+	 * this needs the SubscribeToEvents bit in the EventNotifier attribute of the node. Recordings
+	 * whose Data node emits no events are polled as without the option.
+	 * @param options Readout options; shards and tail are ignored
+	 * @param running Polling stops as soon as this is false
+	 * @return Summary of the read points
+	 */
+	ReadoutSummary follow(const ReadoutOptions& options, const std::atomic<bool>& running);
+
+	/**
+	 * Find the points of a recording missing in a local copy and read only those.
+	 * The found intervals and the missing points are printed to the output of the client.
+	 * @param recordingId Id of the recording to be reconciled
+	 * @param localTimes Timestamps (UTC seconds) of the points held locally
+	 * @param bucketSeconds Width of the coarse time buckets compared first
+	 * @return Summary of the read points
+	 */
+	ReadoutSummary reconcile(const uint32_t& recordingId, std::vector<int64_t> localTimes, const uint32_t& bucketSeconds);
+
+	/**
+	 * Lookup a browsepath to a given NodeId. On the first lookup of a tag the complete table of
+	 * the tag is fetched by a RPC-Call to /Objects/Device/Lookup(). All later lookups of the tag,
+	 * including those of NodeIds unknown to the device, are answered from the cache without
+	 * OPC-UA-Communication. If the table could not be fetched, e.g. after a timeout or a lost
+	 * connection, nothing is cached and the next lookup of the tag requests it again.
 	 * @note For a real application you should think about a Cache-Invalidation
 	 * @param id NodeId of the Node the requested Browsepath belongs to.
 	 * @param tag Group of Measurements that shall be requested. Default is MEASUREMENTS
+	 * @return Browsepath; nullopt if the device does not know the NodeId
 	 */
 	std::optional<std::string> lookup(const NodeId& id, const UA_Tag& tag = UA_TAG_MEASUREMENT);
 
+	/**
+	 * Send the request for the lookup table of a tag without waiting for the response, so it
+	 * overlaps with other requests. The next lookup() of the tag takes over the response.
+	 * @param tag Tag of the table
+	 */
+	void prefetchLookupTable(const UA_Tag& tag);
+
+	/**
+	 * Get all nodes of a lookup table; fetched once like for lookup()
+	 * @param tag Tag of the table
+	 * @return NodeIds with their browse path, ordered by browse path; empty if the table could not be fetched
+	 */
+	std::vector<std::pair<NodeId, std::string>> getLookupTable(const UA_Tag& tag);
+
+	/**
+	 * Read the current values of all nodes of the lookup tables of the given tags (e.g.
+	 * MEASUREMENT and ENERGY) and print them as one block to the output of the client.
+	 * The tables are fetched concurrently, the values with as few Read requests as possible.
+	 * @param tags Tags whose nodes shall be read
+	 * @return Summary; points is the number of printed values
+	 */
+	ReadoutSummary readLiveValues(const std::vector<UA_Tag>& tags);
+
+	/**
+	 * Monitor all nodes of the lookup tables of the given tags with a single subscription and
+	 * print the changed values until stopped. The changes received together are printed as one block.
+	 * @param tags Tags whose nodes shall be monitored
+	 * @param samplingInterval Sampling interval in milliseconds
+	 * @param running Monitoring stops as soon as this is false
+	 * @return Summary; points is the number of printed values
+	 */
+	ReadoutSummary watchLiveValues(const std::vector<UA_Tag>& tags, const double& samplingInterval, const std::atomic<bool>& running);
+
+	/**
+	 * Dictionary of the channels printed to the output of this session
+	 */
+	ChannelDictionary& channels();
+
+	/**
+	 * Select whether printed points refer to their values by channel id (see ChannelDictionary)
+	 * or by full browse path.
+	 * @param enabled true for channel ids
+	 */
+	void setDictionaryOutput(const bool& enabled);
+	bool getDictionaryOutput() const;
+
+	/**
+	 * Select whether every decoded recording point is checked against the protobuf library
+	 * (see RecordedDataDecoder::verify()). This is meant for testing and costs a second decode.
+	 * @param enabled true to check the points
+	 */
+	void setVerifyDecoder(const bool& enabled);
+	bool getVerifyDecoder() const;
+
+	/**
+	 * Controller limiting the number of ReadByStartAndCount() calls outstanding to this device.
+	 * Every session holds at most one of these calls at a time, so the limit takes effect across
+	 * the sessions sharing the controller (see shareConcurrency()), i.e. the shards of a recording.
+	 */
+	ConcurrencyController& concurrency() const;
+
+	/**
+	 * Use the controller of another session to the same device, so the limit applies to both sessions.
+	 * @param other Session whose controller shall be shared
+	 */
+	void shareConcurrency(const Umg801& other);
 
 private:
-	std::map<NodeId,std::string> m_lookupInfo;
+	/**
+	 * Read only the points of a recording newer than its watermark and commit the new watermark
+	 * after the data was made durable.
+	 * @param recording Recording to be synchronized
+	 * @param range Currently available time range of the recording
+	 * @param options Readout options holding the sync state
+	 * @param summary Summary the number of read points is added to
+	 * @return OPC-UA Statuscode
+	 */
+	UA_StatusCode sync(const Recording& recording, const RecordingRange& range, const ReadoutOptions& options, ReadoutSummary& summary);
+
+	/**
+	 * Calculate the next poll time of a recording in follow mode
+	 * @param now Current time
+	 * @param interval Recording interval
+	 * @return Next multiple of interval (UTC) after now plus FollowDelay
+	 */
+	static UA_DateTime nextPoll(const UA_DateTime& now, const UA_DateTime& interval);
+
+	/** Delay of a poll after the end of an interval, so the device has stored the point */
+	static constexpr UA_DateTime FollowDelay = 2 * UA_DATETIME_SEC;
+	/** Publishing interval (ms) of the subscription in follow mode */
+	static constexpr double SubscriptionInterval = 1000.0;
+	/** Monitored recordings are polled anyway after this number of intervals without notification */
+	static constexpr UA_DateTime SafetyPollFactor = 10;
+
+	/**
+	 * Load the metadata snapshot of the device into the caches, if it matches the NamespaceArray
+	 * @param namespaces Current NamespaceArray of the device
+	 * @return true if the snapshot is valid
+	 */
+	bool loadMetadata(const std::vector<std::string>& namespaces);
+
+	/**
+	 * Check that the loaded metadata snapshot still knows all recordings and configurations of
+	 * the device. The Recordings folder and the recordings are browsed with one request each.
+	 * An outdated snapshot is dropped.
+	 * @param recordingsNodeId Node of the Recordings folder
+	 * @return true if the snapshot is still valid
+	 */
+	bool checkMetadata(const NodeId& recordingsNodeId);
+
+	/**
+	 * Save the metadata snapshot of the device, if the caches hold more than the current snapshot,
+	 * e.g. after a full discovery or when configurations were read on demand
+	 * @param recordings Recordings with their configurations
+	 */
+	void saveMetadata(const std::list<Recording>& recordings);
+
+	/**
+	 * Make sure the lookup table of a tag was fetched
+	 * @param tag Tag of the table
+	 * @return GOOD if the table is cached, else the result of the failed fetch
+	 */
+	UA_StatusCode fetchLookupTable(const UA_Tag& tag);
+
+	/**
+	 * Fetch the lookup tables of multiple tags
+	 * @param tags Tags of the tables
+	 * @return Nodes of all tables with their browse path
+	 */
+	std::vector<std::pair<NodeId, std::string>> getLiveNodes(const std::vector<UA_Tag>& tags);
+
+	void printTime(const UA_DateTime& t) const;
+
+	/**
+	 * Print a live value by channel or browse path
+	 * @param out Stream the value is printed to; channel definitions go to the output of the client
+	 * @param name Browse path of the value
+	 * @param value Value to be printed
+	 */
+	void printLiveValue(std::ostream& out, const std::string& name, const UA_DataValue& value);
+
+	/**
+	 * Store the complete lookup table of a tag into the cache
+	 * @param tag Tag of the table
+	 * @param result Result of the call to Lookup()
+	 * @return OPC-UA Statuscode
+	 */
+	UA_StatusCode storeLookupTable(const UA_Tag& tag, const CallResult& result);
+
+	std::unordered_map<LookupKey, std::string, LookupKeyHash> m_lookupInfo;
+	/** Tags whose complete table was fetched */
+	std::set<UA_Tag> m_lookupTables;
+	/** Requested lookup tables whose response was not processed yet */
+	std::map<UA_Tag, std::future<CallResult>> m_pendingLookups;
+	NodeId m_deviceId;
+	NodeId m_lookupMethodId;
+	std::string m_metadataDir;
+	ChannelDictionary m_channels;
+	bool m_dictionaryOutput;
+	bool m_verifyDecoder;
+	MetadataSnapshot m_snapshot;
+	/** NamespaceArray of the device read by getRecordings(); empty without metadata directory */
+	std::vector<std::string> m_namespaces;
+	bool m_snapshotValid;
+	std::shared_ptr<ConcurrencyController> m_concurrency;
 };
 
 #endif /* UMG801_HPP_ */
@@ -6,29 +6,148 @@
 //============================================================================
 
 #include "Umg801.hpp"
+#include "Fleet.hpp"
 
 #include <iostream>
 #include <chrono>
 #include <fstream>
 #include <filesystem>
 #include <cstdlib>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <csignal>
+#include <unistd.h>
+
+static std::atomic<bool> running(true);
+
+static void stop(int) {
+	running = false;
+}
 
 int main(int argc, char* argv[]) {
 	std::string serverHost = "localhost";
 	uint16_t serverPort = 4840;
+	ReadoutOptions options;
+	std::string deviceList;
+	unsigned workers = 8;
+	std::string outputDir = ".";
+	std::string stateFile;
+	int reconcileId = -1;
+	std::string reconcileFile;
+	uint32_t bucketSeconds = 86400;
+	bool follow = false;
+	bool live = false;
+	double samplingInterval = 1000;
 
 	/* Set timezone env for correct localtime */
 	setenv("TZ", "/usr/share/zoneinfo/Europe/Berlin", 1); // POSIX-specific!!
 
-	if(argc >= 2) {
-		serverHost = argv[1];
-		if(argc == 3) {
-			serverPort = std::atoi(argv[2]);
+	std::vector<std::string> args;
+	for(int i=1; i<argc; i++) {
+		const std::string arg = argv[i];
+		if(arg == "--shards" && i+1 < argc) {
+			options.shards = std::atoi(argv[++i]);
+		} else if(arg == "--max-parallel" && i+1 < argc) {
+			options.maxParallel = std::atoi(argv[++i]);
+		} else if(arg == "--tail" && i+1 < argc) {
+			options.tail = std::atoi(argv[++i]);
+		} else if(arg == "--follow") {
+			follow = true;
+		} else if(arg == "--subscribe") {
+			options.subscribe = true;
+		} else if(arg == "--live") {
+			live = true;
+		} else if(arg == "--sampling" && i+1 < argc) {
+			samplingInterval = std::atof(argv[++i]);
+		} else if(arg == "--raw-points") {
+			options.rawRecordingPoints = true;
+		} else if(arg == "--verify-decoder") {
+			options.verifyDecoder = true;
+		} else if(arg == "--names") {
+			options.channelDictionary = false;
+		} else if(arg == "--stream") {
+			options.streaming = true;
+		} else if(arg == "--fleet" && i+1 < argc) {
+			deviceList = argv[++i];
+		} else if(arg == "--workers" && i+1 < argc) {
+			workers = std::atoi(argv[++i]);
+		} else if(arg == "--outdir" && i+1 < argc) {
+			outputDir = argv[++i];
+		} else if(arg == "--state" && i+1 < argc) {
+			stateFile = argv[++i];
+		} else if(arg == "--reconcile" && i+2 < argc) {
+			reconcileId = std::atoi(argv[++i]);
+			reconcileFile = argv[++i];
+		} else if(arg == "--metadata" && i+1 < argc) {
+			options.metadataDir = argv[++i];
+		} else if(arg == "--bucket" && i+1 < argc) {
+			bucketSeconds = std::atoi(argv[++i]);
+		} else {
+			args.push_back(arg);
+		}
+	}
+
+	std::unique_ptr<SyncState> syncState;
+	if(!stateFile.empty()) {
+		syncState = std::make_unique<SyncState>(stateFile);
+		if(!syncState->load()) {
+			return (1);
+		}
+		options.syncState = syncState.get();
+	}
+
+	if(!deviceList.empty()) {
+		// Fleet mode reads out each device once; --tail is applied by the readout of each device
+		if(follow || live || reconcileId >= 0) {
+			std::cerr << "--follow, --live and --reconcile can not be combined with --fleet" << std::endl;
+			return (1);
+		}
+		std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
+		std::vector<Fleet::Device> devices;
+		if(!Fleet::loadDeviceList(deviceList, devices)) {
+			return (1);
+		}
+		const auto results = Fleet(devices, workers, outputDir).run(options);
+		Fleet::printSummary(results, std::cout);
+		std::chrono::high_resolution_clock::time_point t2 = std::chrono::high_resolution_clock::now();
+		auto duration = std::chrono::duration_cast<std::chrono::microseconds>( t2 - t1 ).count();
+		std::cout << "Finished in " << (float)duration/1000000.0 << "s" << std::endl;
+		for(const auto& r : results) {
+			if(r.summary.status != UA_STATUSCODE_GOOD) {
+				return (1);
+			}
+		}
+		return 0;
+	} else if(args.size() >= 1) {
+		serverHost = args[0];
+		if(args.size() == 2) {
+			serverPort = std::atoi(args[1].c_str());
 		}
 	} else {
-		std::cout << "Useage: " << argv[0] << " <host> [<port>]" << std::endl;
+		std::cout << "Useage: " << argv[0] << " [options] <host> [<port>]" << std::endl;
+		std::cout << "       " << argv[0] << " [options] --fleet <file>" << std::endl;
 		std::cout << "\thost:\tHostname/IP of the device to be read out" << std::endl;
 		std::cout << "\tport:\tOPCUA-Port number (optional, defaults to 4840)" << std::endl;
+		std::cout << "Options:" << std::endl;
+		std::cout << "\t--shards <n>\tRead each recording with <n> parallel sessions (defaults to 1)" << std::endl;
+		std::cout << "\t--max-parallel <n>\tUpper limit of parallel ReadByStartAndCount calls of the shards of a recording (defaults to the number of shards)" << std::endl;
+		std::cout << "\t--stream\tDecode each received chunk immediately instead of buffering the whole recording" << std::endl;
+		std::cout << "\t--names\tPrint the full browse path of each value in every point instead of channel ids" << std::endl;
+		std::cout << "\t--raw-points\tLeave the received RecordingPoints encoded and read their data in place (saves one allocation per point)" << std::endl;
+		std::cout << "\t--verify-decoder\tCheck every decoded recording point against the protobuf library and report differences" << std::endl;
+		std::cout << "\t--tail <n>\tOnly read the <n> newest points of each recording" << std::endl;
+		std::cout << "\t--follow\tKeep the session open and print new points of each recording as soon as they are recorded" << std::endl;
+		std::cout << "\t--subscribe\tWith --follow: read a recording when its Data object emits an event instead of polling it; recordings without events are polled" << std::endl;
+		std::cout << "\t--live\tPrint the current values of all measurements and energy values instead of the recordings; with --follow print their changes" << std::endl;
+		std::cout << "\t--sampling <ms>\tSampling interval of the live values with --follow (defaults to 1000)" << std::endl;
+		std::cout << "\t--fleet <file>\tRead out all devices listed in <file> ('<host> [<port>]' per line) concurrently; not with --follow, --live or --reconcile" << std::endl;
+		std::cout << "\t--workers <n>\tMaximum number of devices read out at the same time in fleet mode (defaults to 8)" << std::endl;
+		std::cout << "\t--state <file>\tIncremental sync: only read data newer than the watermarks stored in <file>" << std::endl;
+		std::cout << "\t--reconcile <id> <file>\tRead only the points of recording <id> missing in <file> (one UTC timestamp in seconds per line)" << std::endl;
+		std::cout << "\t--bucket <s>\tWidth of the time buckets compared first when reconciling (defaults to 86400)" << std::endl;
+		std::cout << "\t--metadata <dir>\tKeep a snapshot of the metadata of each device in <dir> to skip the discovery on the next start" << std::endl;
+		std::cout << "\t--outdir <dir>\tDirectory for the per-device output files in fleet mode (defaults to '.')" << std::endl;
 		return 0;
 	}
 
@@ -36,29 +155,58 @@ int main(int argc, char* argv[]) {
 
 	const std::string serverUrl = "opc.tcp://"+serverHost+":"+std::to_string(serverPort);
 	Umg801 umg;
+	umg.setMetadataDir(options.metadataDir);
+	umg.setDictionaryOutput(options.channelDictionary);
+	umg.setVerifyDecoder(options.verifyDecoder);
+	umg.setRawRecordingPoints(options.rawRecordingPoints);
 
 	if(!umg.connect(serverUrl)) {
 		std::cerr << "Failed to connect UMG801 OPCUA-Service on '" << serverUrl << "'!" << std::endl;
 		return (1);
 	}
 
-	int ret = 0;
-	for (const auto& r : umg.getRecordings()) {
-		UA_DateTime startTime, stopTime;
-		/* Here would be a good point to set 'startTime' to last synchronization time,
-		 * so not all data must be fetched every time. After successful read out, 'endTime'
-		 * can be stored as new synchronization time.
-		 * This example just fetches all data, so we grab overall time range from device.
-		 */
-		if(r.getRange(startTime, stopTime) == UA_STATUSCODE_GOOD) {
-			const auto count = r.countByRange(startTime,stopTime);
-			if(count > 0) {
-				std::cout << "Found Recording " << r.getId() << " with " << count << " Points between "
-						<< OpcUaUtil::dateTimeToString(startTime) << " and " << OpcUaUtil::dateTimeToString(stopTime) << std::endl;
-				ret |= (r.readByStartAndCount(startTime, count) != UA_STATUSCODE_GOOD);
-			}
+	if(live) {
+		const std::vector<UA_Tag> tags = {UA_TAG_MEASUREMENT, UA_TAG_ENERGY};
+		ReadoutSummary summary;
+		if(follow) {
+			std::signal(SIGINT, stop);
+			std::signal(SIGTERM, stop);
+			summary = umg.watchLiveValues(tags, samplingInterval, running);
+		} else {
+			summary = umg.readLiveValues(tags);
 		}
+		std::cout << "Read " << summary.points << " live Values" << std::endl;
+		return (summary.status != UA_STATUSCODE_GOOD);
+	}
+
+	if(reconcileId >= 0) {
+		std::vector<int64_t> localTimes;
+		std::ifstream in(reconcileFile);
+		if(!in) {
+			std::cerr << "Failed to open '" << reconcileFile << "'!" << std::endl;
+			return (1);
+		}
+		for(int64_t t; in >> t; ) {
+			localTimes.push_back(t);
+		}
+		const ReadoutSummary summary = umg.reconcile(reconcileId, localTimes, bucketSeconds);
+		std::cout << "Read " << summary.points << " missing Points" << std::endl;
+		return (summary.status != UA_STATUSCODE_GOOD);
+	}
+
+	options.makeDurable = []() {
+		std::cout.flush();
+		return std::cout.good() && SyncState::syncFd(STDOUT_FILENO);
+	};
+	ReadoutSummary summary;
+	if(follow) {
+		std::signal(SIGINT, stop);
+		std::signal(SIGTERM, stop);
+		summary = umg.follow(options, running);
+	} else {
+		summary = umg.readout(options);
 	}
+	const int ret = (summary.status != UA_STATUSCODE_GOOD);
 
 	std::chrono::high_resolution_clock::time_point t2 = std::chrono::high_resolution_clock::now();
 	auto duration = std::chrono::duration_cast<std::chrono::microseconds>( t2 - t1 ).count();
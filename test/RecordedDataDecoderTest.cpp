@@ -0,0 +1,342 @@
+/*
+ * RecordedDataDecoderTest.cpp
+ *
+ *  Created on: 17.10.2026
+ *   Copyright: 2026 by Janitza electronics GmbH
+ */
+
+#include "RecordedDataDecoder.hpp"
+
+#include <iostream>
+#include <random>
+#include <string>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+/*
+ * Checks that RecordedDataDecoder::decode() yields the same values as the generated protobuf
+ * parser for random RecordedData messages: all tuple types, negative zigzag values, empty tuples,
+ * packed and unpacked fields, split and unknown fields. Smaller messages are also truncated at
+ * every length. RecordedDataDecoder::decodeRecordingPoint() is checked with valid, null, short
+ * and oversized RecordingPoint bodies.
+ */
+namespace {
+
+/** Messages compared as a whole */
+constexpr unsigned Messages = 2000;
+constexpr unsigned MaxValues = 40;
+/** Smaller messages compared at every truncated length */
+constexpr unsigned TruncatedMessages = 300;
+constexpr unsigned TruncatedMaxValues = 6;
+
+std::mt19937_64 rng(801);
+
+/** Random 64 bit pattern with a random number of significant bits, so all varint lengths occur */
+uint64_t randomBits() {
+	const unsigned bits = rng() % 65;
+	return bits == 64 ? rng() : (rng() & ((uint64_t(1) << bits) - 1));
+}
+
+/** Random value; signed values are negative half of the time */
+template<typename T>
+T randomValue() {
+	if constexpr(std::is_same<T, bool>::value) {
+		return rng() & 1;
+	} else if constexpr(std::is_floating_point<T>::value) {
+		// Any bit pattern, including NaN and infinity
+		using Bits = typename std::conditional<sizeof(T) == 8, uint64_t, uint32_t>::type;
+		const Bits bits = static_cast<Bits>(rng());
+		T v;
+		std::memcpy(&v, &bits, sizeof(v));
+		return v;
+	} else if constexpr(std::is_signed<T>::value) {
+		const T v = static_cast<T>(randomBits());
+		return (rng() & 1) ? v : -(v & std::numeric_limits<T>::max());
+	} else {
+		return static_cast<T>(randomBits());
+	}
+}
+
+/** Fill the columns of a tuple message; each column is left empty in one of four cases */
+template<typename T, typename Tuple>
+void fillTuple(Tuple& tuple, const unsigned& maxValues) {
+	const auto count = [&maxValues] { return (rng() % 4) ? rng() % maxValues : 0; };
+	for(auto n = count(); n > 0; n--) tuple.add_sample(randomValue<T>());
+	for(auto n = count(); n > 0; n--) tuple.add_avgvalue(randomValue<T>());
+	for(auto n = count(); n > 0; n--) tuple.add_minvalue(randomValue<T>());
+	for(auto n = count(); n > 0; n--) tuple.add_mintimestamp(randomValue<int64_t>());
+	for(auto n = count(); n > 0; n--) tuple.add_maxvalue(randomValue<T>());
+	for(auto n = count(); n > 0; n--) tuple.add_maxtimestamp(randomValue<int64_t>());
+}
+
+records::RecordedData randomMessage(const unsigned& maxValues) {
+	records::RecordedData message;
+	if(rng() % 4) {
+		message.set_starttimeutc(randomValue<int64_t>());
+	}
+	// A tuple is missing, present but empty, or filled
+	const auto tuple = [] { return rng() % 3; };
+	if(const auto t = tuple()) { auto* m = message.mutable_double_(); if(t == 2) fillTuple<double>(*m, maxValues); }
+	if(const auto t = tuple()) { auto* m = message.mutable_float_(); if(t == 2) fillTuple<float>(*m, maxValues); }
+	if(const auto t = tuple()) { auto* m = message.mutable_uint32(); if(t == 2) fillTuple<uint32_t>(*m, maxValues); }
+	if(const auto t = tuple()) { auto* m = message.mutable_sint32(); if(t == 2) fillTuple<int32_t>(*m, maxValues); }
+	if(const auto t = tuple()) { auto* m = message.mutable_uint64(); if(t == 2) fillTuple<uint64_t>(*m, maxValues); }
+	if(const auto t = tuple()) { auto* m = message.mutable_sint64(); if(t == 2) fillTuple<int64_t>(*m, maxValues); }
+	if(const auto t = tuple()) { auto* m = message.mutable_bool_(); if(t == 2) fillTuple<bool>(*m, maxValues); }
+	return message;
+}
+
+/*
+ * Encoder of the wire format for messages the generated serializer does not write:
+ * unpacked repeated fields, tuples split into multiple occurrences and unknown fields
+ */
+void putVarint(std::string& out, uint64_t v) {
+	while(v >= 0x80) {
+		out += static_cast<char>(v | 0x80);
+		v >>= 7;
+	}
+	out += static_cast<char>(v);
+}
+
+void putTag(std::string& out, const uint32_t& field, const uint32_t& wireType) {
+	putVarint(out, (uint64_t(field) << 3) | wireType);
+}
+
+void putLengthDelimited(std::string& out, const uint32_t& field, const std::string& body) {
+	putTag(out, field, 2);
+	putVarint(out, body.size());
+	out += body;
+}
+
+/** Wire type and encoding of the values of a column */
+template<typename V> struct Wire;
+template<> struct Wire<double> {
+	static constexpr uint32_t Type = 1;
+	static void put(std::string& out, const double& v) { out.append(reinterpret_cast<const char*>(&v), sizeof(v)); }
+};
+template<> struct Wire<float> {
+	static constexpr uint32_t Type = 5;
+	static void put(std::string& out, const float& v) { out.append(reinterpret_cast<const char*>(&v), sizeof(v)); }
+};
+template<> struct Wire<uint32_t> {
+	static constexpr uint32_t Type = 0;
+	static void put(std::string& out, const uint32_t& v) { putVarint(out, v); }
+};
+template<> struct Wire<int32_t> { // sint32
+	static constexpr uint32_t Type = 0;
+	static void put(std::string& out, const int32_t& v) { putVarint(out, (uint32_t(v) << 1) ^ uint32_t(v >> 31)); }
+};
+template<> struct Wire<uint64_t> {
+	static constexpr uint32_t Type = 0;
+	static void put(std::string& out, const uint64_t& v) { putVarint(out, v); }
+};
+template<> struct Wire<int64_t> { // sint64
+	static constexpr uint32_t Type = 0;
+	static void put(std::string& out, const int64_t& v) { putVarint(out, (uint64_t(v) << 1) ^ uint64_t(v >> 63)); }
+};
+template<> struct Wire<uint8_t> { // bool
+	static constexpr uint32_t Type = 0;
+	static void put(std::string& out, const uint8_t& v) { putVarint(out, v); }
+};
+/** Timestamps are plain int64 */
+struct TimestampWire {
+	static constexpr uint32_t Type = 0;
+	static void put(std::string& out, const int64_t& v) { putVarint(out, static_cast<uint64_t>(v)); }
+};
+
+/** Encode a column packed, unpacked or as a mix of both */
+template<typename W, typename V>
+void putColumn(std::string& out, const uint32_t& field, const std::vector<V>& column) {
+	size_t i = 0;
+	while(i < column.size()) {
+		const size_t run = 1 + rng() % (column.size() - i);
+		if(rng() & 1) {
+			std::string packed;
+			for(size_t n = 0; n < run; n++) W::put(packed, column[i + n]);
+			putLengthDelimited(out, field, packed);
+		} else {
+			for(size_t n = 0; n < run; n++) {
+				putTag(out, field, W::Type);
+				W::put(out, column[i + n]);
+			}
+		}
+		i += run;
+	}
+}
+
+/** Encode a tuple; its columns are spread over one or two occurrences of the tuple field */
+template<typename T>
+void putTuple(std::string& out, const uint32_t& field, const RecordedTuple<T>& tuple) {
+	using Value = typename RecordedTuple<T>::Value;
+	std::string body[2];
+	const auto part = [&body] () -> std::string& { return body[rng() & 1]; };
+	putColumn<Wire<Value>>(part(), 1, tuple.samples);
+	putColumn<Wire<Value>>(part(), 2, tuple.avgValues);
+	putColumn<Wire<Value>>(part(), 3, tuple.minValues);
+	putColumn<TimestampWire>(part(), 4, tuple.minTimestamps);
+	putColumn<Wire<Value>>(part(), 5, tuple.maxValues);
+	putColumn<TimestampWire>(part(), 6, tuple.maxTimestamps);
+	if(rng() % 4 == 0) {
+		// Unknown field within the tuple
+		putTag(body[1], 9, 0);
+		putVarint(body[1], randomBits());
+	}
+	putLengthDelimited(out, field, body[0]);
+	if(!body[1].empty() || rng() % 4 == 0) {
+		putLengthDelimited(out, field, body[1]);
+	}
+}
+
+std::string encodeUnpacked(const RecordedColumns& point) {
+	std::string out;
+	putTag(out, 1, 0);
+	putVarint(out, static_cast<uint64_t>(point.startTimeUtc));
+	if(rng() & 1) putTuple(out, 2, point.doubles);
+	if(rng() & 1) putTuple(out, 3, point.floats);
+	if(rng() & 1) putTuple(out, 4, point.uint32s);
+	if(rng() & 1) putTuple(out, 5, point.sint32s);
+	if(rng() & 1) putTuple(out, 6, point.uint64s);
+	if(rng() & 1) putTuple(out, 7, point.sint64s);
+	if(rng() & 1) putTuple(out, 8, point.bools);
+	if(rng() % 4 == 0) {
+		// Unknown fields of all wire types
+		putTag(out, 20, 0);
+		putVarint(out, randomBits());
+		putTag(out, 21, 1);
+		out.append(8, '\x5a');
+		putLengthDelimited(out, 22, "unknown");
+		putTag(out, 23, 5);
+		out.append(4, '\xa5');
+	}
+	return out;
+}
+
+/**
+ * Decode a buffer with both decoders
+ * @return false if the decoders disagree
+ */
+bool compare(const std::string& buffer, const char* what, const unsigned& message) {
+	thread_local records::RecordedData protobuf;
+	thread_local RecordedColumns expected;
+	thread_local RecordedColumns decoded;
+	const uint8_t* data = reinterpret_cast<const uint8_t*>(buffer.data());
+	const bool parsed = protobuf.ParseFromArray(data, buffer.size());
+	const bool ok = RecordedDataDecoder::decode(data, buffer.size(), decoded);
+	if(parsed != ok) {
+		std::cerr << what << " message " << message << " (" << buffer.size() << " bytes): "
+				<< (parsed ? "rejected by decode()" : "rejected by protobuf only") << std::endl;
+		return false;
+	}
+	if(parsed) {
+		RecordedDataDecoder::fromProtobuf(protobuf, expected);
+		if(!(expected == decoded)) {
+			std::cerr << what << " message " << message << " (" << buffer.size() << " bytes): values differ" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+/** Compare the buffer truncated at every length, including the whole buffer */
+bool compareTruncated(const std::string& buffer, const char* what, const unsigned& message) {
+	bool ok = true;
+	for(size_t length = 0; length <= buffer.size(); length++) {
+		ok = compare(buffer.substr(0, length), what, message) && ok;
+	}
+	return ok;
+}
+
+/** Binary encoded body of a RecordingPoint: UInt32 configId, Int32 length and the data */
+std::string recordingPointBody(const uint32_t& configId, const int32_t& length, const std::string& data) {
+	std::string body;
+	for(const uint32_t v : {configId, static_cast<uint32_t>(length)}) {
+		for(unsigned shift = 0; shift < 32; shift += 8) {
+			body += static_cast<char>(v >> shift);
+		}
+	}
+	return body + data;
+}
+
+/**
+ * Walk a RecordingPoint body and check the result
+ * @param data Expected data; nullptr if the body must be rejected, empty for a null ByteString
+ * @return false on mismatch
+ */
+bool checkRecordingPoint(const std::string& body, const char* what, const uint32_t& configId, const std::string* data) {
+	RecordingPointView point;
+	const uint8_t* p = reinterpret_cast<const uint8_t*>(body.data());
+	const bool ok = RecordedDataDecoder::decodeRecordingPoint(p, body.size(), point);
+	if(ok != (data != nullptr)) {
+		std::cerr << "RecordingPoint " << what << ": " << (ok ? "accepted" : "rejected") << std::endl;
+		return false;
+	}
+	if(ok && (point.configId != configId || point.length != data->size()
+			|| (point.length && (point.data != p + 8 || std::memcmp(point.data, data->data(), point.length))))) {
+		std::cerr << "RecordingPoint " << what << ": wrong configId or data" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+/** @return Number of failed RecordingPoint checks */
+unsigned checkRecordingPoints() {
+	unsigned failures = 0;
+	for(unsigned m = 0; m < 100; m++) {
+		const uint32_t configId = static_cast<uint32_t>(rng());
+		const std::string data = randomMessage(MaxValues).SerializeAsString();
+		const int32_t length = data.size();
+		const std::string body = recordingPointBody(configId, length, data);
+		failures += !checkRecordingPoint(body, "valid", configId, &data);
+		// The data refers to the body, so the protobuf message decodes in place
+		RecordingPointView point;
+		RecordedColumns decoded;
+		if(!RecordedDataDecoder::decodeRecordingPoint(reinterpret_cast<const uint8_t*>(body.data()), body.size(), point)
+				|| !RecordedDataDecoder::decode(point.data, point.length, decoded)
+				|| !RecordedDataDecoder::verify(point.data, point.length, decoded)) {
+			std::cerr << "RecordingPoint data differs from protobuf library" << std::endl;
+			failures++;
+		}
+		// Bytes after the data are not part of the point
+		failures += !checkRecordingPoint(body + "trailing", "with trailing bytes", configId, &data);
+		// Data longer than the body
+		failures += !checkRecordingPoint(recordingPointBody(configId, length + 1, data), "oversized", configId, nullptr);
+		// Body truncated within the header or the data
+		failures += !checkRecordingPoint(body.substr(0, rng() % 8), "short header", configId, nullptr);
+		if(length > 0) {
+			failures += !checkRecordingPoint(body.substr(0, 8 + rng() % length), "truncated", configId, nullptr);
+		}
+	}
+	const std::string empty;
+	failures += !checkRecordingPoint(recordingPointBody(7, -1, ""), "null", 7, &empty);
+	failures += !checkRecordingPoint(recordingPointBody(7, 0, ""), "empty", 7, &empty);
+	failures += !checkRecordingPoint(recordingPointBody(7, -2, ""), "negative length", 7, nullptr);
+	failures += !checkRecordingPoint(recordingPointBody(7, std::numeric_limits<int32_t>::max(), "data"), "maximum length", 7, nullptr);
+	failures += !checkRecordingPoint(recordingPointBody(7, std::numeric_limits<int32_t>::min(), "data"), "minimum length", 7, nullptr);
+	return failures;
+}
+
+}
+
+int main() {
+	unsigned failures = 0;
+	for(unsigned m = 0; m < Messages + TruncatedMessages; m++) {
+		const bool truncated = (m >= Messages);
+		const records::RecordedData message = randomMessage(truncated ? TruncatedMaxValues : MaxValues);
+		RecordedColumns point;
+		RecordedDataDecoder::fromProtobuf(message, point);
+		const std::string packed = message.SerializeAsString();
+		const std::string unpacked = encodeUnpacked(point);
+		if(truncated) {
+			failures += !compareTruncated(packed, "Packed", m);
+			failures += !compareTruncated(unpacked, "Unpacked", m);
+		} else {
+			failures += !compare(packed, "Packed", m);
+			failures += !compare(unpacked, "Unpacked", m);
+		}
+	}
+	std::cout << failures << " of " << 2 * (Messages + TruncatedMessages) << " messages decoded differently" << std::endl;
+	const unsigned pointFailures = checkRecordingPoints();
+	std::cout << pointFailures << " RecordingPoint checks failed" << std::endl;
+	return (failures || pointFailures) ? 1 : 0;
+}